@@ -67,7 +67,41 @@ target_include_directories(RtMidi
         "${RtMidi_SOURCE_DIR}"
 )
 
-target_compile_definitions(RtMidi
-    PUBLIC
-        "-D__WINDOWS_MM__"
-)
+# RtMidi is built for the native MIDI API of the platform
+if (WIN32)
+    target_compile_definitions(RtMidi
+        PUBLIC
+            "-D__WINDOWS_MM__"
+    )
+
+    target_link_libraries(RtMidi
+        PUBLIC
+            winmm
+    )
+elseif (APPLE)
+    target_compile_definitions(RtMidi
+        PUBLIC
+            "-D__MACOSX_CORE__"
+    )
+
+    target_link_libraries(RtMidi
+        PUBLIC
+            "-framework CoreMIDI"
+            "-framework CoreAudio"
+            "-framework CoreFoundation"
+    )
+else()
+    find_package(ALSA REQUIRED)
+    find_package(Threads REQUIRED)
+
+    target_compile_definitions(RtMidi
+        PUBLIC
+            "-D__LINUX_ALSA__"
+    )
+
+    target_link_libraries(RtMidi
+        PUBLIC
+            ALSA::ALSA
+            Threads::Threads
+    )
+endif()
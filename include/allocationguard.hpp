@@ -0,0 +1,22 @@
+#ifndef ALLOCATIONGUARD_H
+#define ALLOCATIONGUARD_H
+
+// While a NoAllocationScope is alive on a thread, any heap allocation on
+// that thread asserts. The check is only compiled in with
+// ARP_CHECK_ALLOCATIONS, otherwise the scope does nothing.
+class NoAllocationScope
+{
+public:
+#ifdef ARP_CHECK_ALLOCATIONS
+    NoAllocationScope();
+    ~NoAllocationScope();
+#else
+    NoAllocationScope() {}
+    ~NoAllocationScope() {}
+#endif
+
+    NoAllocationScope(const NoAllocationScope &) = delete;
+    NoAllocationScope &operator=(const NoAllocationScope &) = delete;
+};
+
+#endif // ALLOCATIONGUARD_H
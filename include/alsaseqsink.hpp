@@ -0,0 +1,70 @@
+#ifndef ALSASEQSINK_H
+#define ALSASEQSINK_H
+
+#include <midisink.hpp>
+
+#include <alsa/asoundlib.h>
+
+// Output through the ALSA sequencer. Messages are put on a sequencer queue
+// with a real-time timestamp, so the kernel delivers them at their due time
+// even when our process is not scheduled at that moment.
+class AlsaSeqSink : public MidiSink
+{
+public:
+    // Messages are handed to the queue this far ahead of their due time
+    static const long long DefaultLookahead = 10000000LL;
+
+    AlsaSeqSink(
+        long long lookahead = DefaultLookahead);
+
+    virtual ~AlsaSeqSink();
+
+    bool Init() override;
+
+    std::vector<std::string> PortNames() override;
+
+    void OpenPort(
+        unsigned int port) override;
+
+    void ClosePort() override;
+
+    long long Lookahead() const override;
+
+    void Send(
+        long long time,
+        const unsigned char *message,
+        size_t size) override;
+
+    // Puts the whole batch in the output buffer and drains it once
+    void SendBatch(
+        const struct tMidiMessage *messages,
+        size_t count) override;
+
+    void DropPending() override;
+
+private:
+    long long _lookahead;
+    snd_seq_t *_seq = nullptr;
+    snd_midi_event_t *_encoder = nullptr;
+    int _port = -1;
+    int _queue = -1;
+
+    // Engine clock time at which the queue started, queue time is relative
+    // to this
+    long long _queueStart = 0;
+
+    // Destinations in PortNames order, and the one we are connected to
+    std::vector<snd_seq_addr_t> _destinations;
+    bool _connected = false;
+    snd_seq_addr_t _connection = {0, 0};
+
+    long long QueueTime() const;
+
+    // Adds one message to the output buffer without draining it
+    void Output(
+        long long time,
+        const unsigned char *message,
+        size_t size);
+};
+
+#endif // ALSASEQSINK_H
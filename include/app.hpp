@@ -1,11 +1,14 @@
 #ifndef APP_H
 #define APP_H
 
-#include <set>
 #include <string>
 #include <vector>
 
-#include <RtMidi.h>
+#include <dinoutput.hpp>
+#include <engine.hpp>
+#include <midiinput.hpp>
+#include <midisink.hpp>
+#include <tracer.hpp>
 
 struct tChannel
 {
@@ -15,8 +18,7 @@ struct tChannel
     int _octaveShift = 3;
     unsigned char _velocity = 100;
     float _noteLength = 0.4f;
-    std::vector<unsigned char> _notesToArp;
-    size_t _currentNote = 0;
+    int _inputChannel = InputOmni;
 };
 
 class App
@@ -33,25 +35,46 @@ public:
     void OnResize(int width, int height);
     void OnExit();
 
+    // Input or anything else that needs the window drawn again
+    void Invalidate();
+
     template <class T>
     T *GetWindowHandle() const;
 
-    void RunNotes();
-
 protected:
     const std::vector<std::string> &_args;
     int _width = 1024;
     int _height = 585;
 
+    // Frame rate while the UI or the engine changes, and while nothing does
+    int _maxFps = 60;
+    int _idleFps = 4;
+
+    // Frames still to draw after input, ImGui takes a few to settle
+    int _pendingFrames = 0;
+    unsigned long long _engineChanges = 0;
+
+    bool NeedsFrame() const;
+
     template <class T>
     void SetWindowHandle(T *handle);
 
     void ClearWindowHandle();
 
-    RtMidiOut *_midiout = nullptr;
+    MidiSink *_sink = nullptr;
     std::vector<std::string> _portNames;
 
-    std::set<unsigned int> notesDown;
+    // The sink itself when the DIN output stage is on, for its stats
+    DinOutputSink *_din = nullptr;
+
+    // Outlives the engine, which records into it
+    Tracer _tracer;
+    Engine _engine;
+    MidiInput *_input = nullptr;
+    std::vector<std::string> _inputPortNames;
+
+    // Keys held down on the piano, per MIDI channel
+    NoteBitmap _notesDown[16];
     bool pauseMode = true;
     bool recordMode = true;
     float _bpm = 100;
@@ -71,6 +94,12 @@ protected:
     void RemoveChannel(
         struct tChannel &ch);
 
+    void PostChannelCommand(
+        const struct tChannel &ch,
+        tEngineCommand command);
+
+    void PostPlaying();
+
 private:
     void *_windowHandle;
 };
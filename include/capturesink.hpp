@@ -0,0 +1,48 @@
+#ifndef CAPTURESINK_H
+#define CAPTURESINK_H
+
+#include <midisink.hpp>
+
+#include <fstream>
+
+// Writes every message with its due time to a binary file instead of a
+// port, for tests and for comparing runs. The file starts with the 8 bytes
+// "ARPCAP01", then per message its time as a little-endian 64 bit count of
+// nanoseconds, its size in one byte and its bytes. Messages are only
+// captured while the port is open.
+class CaptureSink : public MidiSink
+{
+public:
+    static const char *const DefaultPath;
+
+    CaptureSink(
+        const std::string &path);
+
+    virtual ~CaptureSink();
+
+    bool Init() override;
+
+    std::vector<std::string> PortNames() override;
+
+    void OpenPort(
+        unsigned int port) override;
+
+    void ClosePort() override;
+
+    void Send(
+        long long time,
+        const unsigned char *message,
+        size_t size) override;
+
+private:
+    std::string _path;
+    std::ofstream _file;
+    bool _open = false;
+};
+
+bool ReadCapture(
+    const std::string &path,
+    std::vector<struct tMidiMessage> &messages,
+    std::string &error);
+
+#endif // CAPTURESINK_H
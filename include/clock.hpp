@@ -0,0 +1,37 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+// Time source of the engine, in nanoseconds. The engine thread sleeps on the
+// steady clock, so only an engine that is driven by hand (offline rendering,
+// tests, benchmarks) can run on another clock.
+class Clock
+{
+public:
+    virtual ~Clock();
+
+    virtual long long Now() const = 0;
+};
+
+class SteadyClock : public Clock
+{
+public:
+    long long Now() const override;
+};
+
+// Only moves when told to, so every run sees exactly the same times
+class VirtualClock : public Clock
+{
+public:
+    long long Now() const override;
+
+    void Set(
+        long long now);
+
+    void Advance(
+        long long duration);
+
+private:
+    long long _now = 0;
+};
+
+#endif // CLOCK_H
@@ -0,0 +1,105 @@
+#ifndef DINOUTPUT_H
+#define DINOUTPUT_H
+
+#include <midisink.hpp>
+
+#include <array>
+#include <atomic>
+
+struct tDinOutputStats
+{
+    // Bytes on the wire
+    long long _sentBytes = 0;
+
+    // Bytes still waiting for the wire when the last message came in, and
+    // the most there ever were
+    long long _queuedBytes = 0;
+    long long _maxQueuedBytes = 0;
+
+    // Low priority messages that would have been too late
+    long long _droppedMessages = 0;
+    long long _droppedBytes = 0;
+};
+
+// Output stage for a 5-pin DIN port, which carries only 3125 bytes per
+// second. It keeps track of when the wire is free again and hands every
+// message over at the start of its slot on the wire, so a sink that
+// schedules spreads a burst out instead of piling it up in the interface.
+// Of the messages due at the same time clock goes first, as it can be sent
+// in between the bytes of other messages, then note-offs, then note-ons and
+// other system messages. Everything else (controllers, pitch bend, ...) is
+// spread out behind them, and dropped when it would be more than maxDelay
+// late. Sends through another sink, which it owns. Sinks take whole
+// messages, so the budget counts every status byte even where the interface
+// uses running status. A sink without lookahead sends everything right
+// away, then only the dropping helps.
+class DinOutputSink : public MidiSink
+{
+public:
+    static const long long DefaultBytesPerSecond = 3125;
+    static const long long DefaultMaxDelay = 10000000LL;
+
+    DinOutputSink(
+        MidiSink *output,
+        long long bytesPerSecond = DefaultBytesPerSecond,
+        long long maxDelay = DefaultMaxDelay);
+
+    virtual ~DinOutputSink();
+
+    bool Init() override;
+
+    std::vector<std::string> PortNames() override;
+
+    void OpenPort(
+        unsigned int port) override;
+
+    void ClosePort() override;
+
+    long long Lookahead() const override;
+
+    void Send(
+        long long time,
+        const unsigned char *message,
+        size_t size) override;
+
+    void SendBatch(
+        const struct tMidiMessage *messages,
+        size_t count) override;
+
+    void DropPending() override;
+
+    bool PollTransport(
+        struct tExternalTransport &transport) override;
+
+    void SetTransportCallback(
+        TransportCallback callback,
+        void *arg) override;
+
+    // Safe to read from any thread
+    tDinOutputStats Stats() const;
+
+private:
+    MidiSink *_output;
+    long long _byteTime;
+    long long _maxDelay;
+
+    // Engine clock time at which the last byte handed over leaves the wire
+    long long _wireFree = 0;
+
+    std::atomic<long long> _sentBytes{0};
+    std::atomic<long long> _queuedBytes{0};
+    std::atomic<long long> _maxQueuedBytes{0};
+    std::atomic<long long> _droppedMessages{0};
+    std::atomic<long long> _droppedBytes{0};
+
+    // Messages with their slot on the wire, handed to the output as one batch
+    std::array<struct tMidiMessage, 512> _scheduled;
+    size_t _scheduledCount = 0;
+
+    void Schedule(
+        const struct tMidiMessage &message);
+
+    void Flush();
+};
+
+#endif // DINOUTPUT_H
@@ -0,0 +1,342 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <clock.hpp>
+#include <histogram.hpp>
+#include <midiclockfollower.hpp>
+#include <midisink.hpp>
+#include <notebitmap.hpp>
+#include <realtime.hpp>
+#include <spscqueue.hpp>
+#include <tracer.hpp>
+#include <waketimer.hpp>
+
+// Nanoseconds per beat at 1 milli-BPM
+const long long NanosecondsPerBeat = 60000000000000LL;
+
+// One arp step is one beat, four of them make a bar
+const int StepsPerBar = 4;
+
+enum ArpModes
+{
+    Up = 0,
+    Down = 1,
+    Inclusive = 2,
+    Exclusive = 3,
+    Random = 4,
+    Order = 5,
+};
+
+// Input routing of a channel, a MIDI channel 0-15 or one of these
+const int InputOff = -1;
+const int InputOmni = 16;
+
+// Everything the UI wants to change in the playback state is posted as one of
+// these commands, the engine thread applies them between ticks.
+enum class EngineCommandTypes
+{
+    AddChannel,
+    RemoveChannel,
+    SetMidiChannel,
+    SetArpMode,
+    SetVelocity,
+    SetNoteLength,
+    AddNote,
+    TransposeNotes,
+    ClearNotes,
+    SetBpm,
+    SetPlaying,
+    SetSeed,
+    NoteOn,
+    NoteOff,
+    OpenPort,
+    ClosePort,
+    SetInputChannel,
+    SetRecording,
+    SetFollowClock,
+    SetSendClock,
+};
+
+struct tEngineCommand
+{
+    EngineCommandTypes _type;
+    size_t _channelIndex = 0;
+    unsigned char _note = 0;
+    int _value = 0;
+    float _floatValue = 0.0f;
+};
+
+// A message from a MIDI input with the time it came in
+struct tMidiInputEvent
+{
+    long long _time = 0;
+    unsigned char _data[3] = {0, 0, 0};
+    unsigned char _size = 0;
+};
+
+struct tArpChannel
+{
+    unsigned char _channel = 0;
+    int _arpMode = 0;
+    unsigned char _velocity = 100;
+    float _noteLength = 0.4f;
+    int _inputChannel = InputOmni;
+    std::vector<unsigned char> _notesToArp;
+    NoteBitmap _pool;
+    size_t _currentNote = 0;
+
+    // The pool in the order it is played: ascending for every mode except
+    // Order, which plays in recording order. Only updated when the pool or
+    // the mode changes.
+    std::vector<unsigned char> _playOrder;
+
+    // Playback state, every channel runs its own phase on the shared grid
+    long long _step = 0;
+    int _direction = 1;
+    NoteBitmap _soundingNotes;
+    long long _noteOffDue = 0;
+};
+
+// How well the engine keeps up with its own step grid. The tempo error is
+// the difference between the tempo that was actually played since the last
+// tempo change (or start) and the requested tempo, over all channels.
+struct tTransportStats
+{
+    float _tempoError = 0.0f;
+    float _maxLatenessMs = 0.0f;
+    long long _missedSteps = 0;
+
+    // Longest time from a MIDI input callback to the engine acting on it
+    float _maxInputLatencyMs = 0.0f;
+
+    // Tempo of the incoming MIDI clock when following it, 0 until locked
+    float _clockBpm = 0.0f;
+};
+
+// Timing of every message sent on one MIDI channel: how long after it was
+// due at the sink it was handed over, which for a sink with lookahead is
+// that far before the message itself is due, and how long the sink took
+// with the batch that carried it
+struct tChannelTiming
+{
+    Histogram _lateness;
+    Histogram _sendDuration;
+};
+
+class Engine
+{
+public:
+    static const size_t MaxChannels = 64;
+    static const size_t MaxNotes = 128;
+
+    Engine(
+        size_t channelSlots = MaxChannels);
+    virtual ~Engine();
+
+    // Only before Start, the options are applied to the engine thread when
+    // it starts
+    void SetRealtime(
+        const struct tRealtimeOptions &options);
+
+    // Only before Start, ticks and sends are recorded on its engine track
+    void SetTracer(
+        Tracer *tracer);
+
+    void Start(
+        MidiSink *sink);
+
+    // What could not be applied of the realtime options, empty when all
+    // went well
+    const std::vector<std::string> &RealtimeProblems() const;
+
+    void Stop();
+
+    bool Post(
+        const tEngineCommand &command);
+
+    // Posts and, when the queue is full, waits for the engine to make room.
+    // For the UI and other callers that must not lose a command, channel
+    // indices for one would no longer match.
+    void PostWaiting(
+        const tEngineCommand &command);
+
+    // Hands a message from a MIDI input to the engine. Only one input thread
+    // may call this, it never blocks or allocates.
+    bool Receive(
+        long long time,
+        const unsigned char *message,
+        size_t size);
+
+    tTransportStats Stats() const;
+
+    // Goes up every time a step plays, so a UI can tell when the playhead
+    // moved without redrawing all the time
+    unsigned long long Changes() const;
+
+    // Safe to read from any thread while the engine runs
+    const struct tChannelTiming &Timing(
+        int midiChannel) const;
+
+    // Replaces the steady clock, only before Start or when the engine is
+    // driven by hand. The engine does not take ownership.
+    void SetClock(
+        Clock *clock);
+
+protected:
+    MidiSink *_sink = nullptr;
+    std::vector<struct tArpChannel> _channels;
+    bool _playing = false;
+    long long _milliBpm = 100000;
+
+    void Run();
+
+    void Apply(
+        const tEngineCommand &command);
+
+    // Monitors note-ons and offs on every channel the input is routed to,
+    // and adds the notes to their pools while recording
+    void ApplyInput(
+        const tMidiInputEvent &event);
+
+    long long Now() const;
+
+    long long RunNotes();
+
+    long long StepTime(
+        long long step) const;
+
+    long long StepAt(
+        long long time) const;
+
+    // Same for the MIDI clock output, 24 pulses per step
+    long long PulseTime(
+        long long pulse) const;
+
+    long long PulseAt(
+        long long time) const;
+
+    void Rebase();
+
+    // Changes the tempo without moving the steps that already passed
+    void SetTempo(
+        long long milliBpm);
+
+    // Moves the step grid so step n falls on beat n of an external timeline,
+    // given the time of one of its beats
+    void Align(
+        long long beat,
+        long long beatTime);
+
+    // Follows tempo, position and play state of the sink's timeline
+    void FollowTransport();
+
+    // Wakes the engine thread when the sink's timeline changed
+    static void TransportCallback(
+        void *arg);
+
+    void ApplyTransport(
+        const struct tExternalTransport &transport);
+
+    void StopPlaying();
+
+    // Announces the position on the clock output and continues the clock
+    // from the next beat
+    void StartClock();
+
+    void SendRealtime(
+        long long time,
+        unsigned char status);
+
+    // Output of every message with the time it is due at, override to
+    // capture what the engine plays. Messages are collected and go to the
+    // sink together on Flush.
+    virtual void Send(
+        long long time,
+        unsigned char status,
+        unsigned char data1,
+        unsigned char data2);
+
+    // Hands everything collected since the last flush to the sink in one
+    // batch, in time order with note-offs before anything else at the same
+    // time
+    void Flush();
+
+    void NotesOff(
+        struct tArpChannel &ch,
+        long long time);
+
+    void AllNotesOff();
+
+private:
+    SteadyClock _steadyClock;
+    Clock *_clock = &_steadyClock;
+
+    // Drives Random mode, seeded with SetSeed so runs can be repeated
+    std::minstd_rand _random;
+
+    std::thread _thread;
+    std::atomic<bool> _running{false};
+    struct tRealtimeOptions _realtime;
+    std::vector<std::string> _realtimeProblems;
+    Tracer *_tracer = nullptr;
+    SpscQueue<tEngineCommand, 1024> _commands;
+    SpscQueue<tMidiInputEvent, 1024> _input;
+    bool _recording = false;
+
+    // Tempo, position and play state come from the MIDI input's clock
+    bool _followClock = false;
+    MidiClockFollower _clockFollower;
+    std::atomic<long long> _clockMilliBpm{0};
+
+    // MIDI clock output, pulse n is due at PulseTime(n)
+    bool _sendClock = false;
+    long long _clockPulse = 0;
+
+    // The engine thread sleeps on this until the next event is due, Post,
+    // Receive and the sink's transport callback wake it up early.
+    WakeTimer _wakeTimer;
+
+    // Channel slots with their buffers already reserved, so adding and
+    // removing channels on the engine thread does not allocate.
+    std::vector<struct tArpChannel> _freeChannels;
+
+    // All times are integer nanoseconds on the steady clock. Step n is due
+    // at _origin + n * step length, so lateness of one step never carries
+    // over into the next one.
+    long long _origin = 0;
+
+    std::atomic<float> _tempoError{0.0f};
+    std::atomic<long long> _maxLateness{0};
+    std::atomic<long long> _missedSteps{0};
+    std::atomic<long long> _maxInputLatency{0};
+    std::atomic<unsigned long long> _changes{0};
+    struct tChannelTiming _timing[16];
+
+    // Messages of the current tick. RunNotes sends at most a note-off and a
+    // note-on per channel and a beat of clock, the buffer holds that for
+    // every channel slot. Only a flood of commands in one tick can fill it,
+    // then it is flushed early and sorted per flush.
+    std::vector<struct tMidiMessage> _batch;
+    std::vector<struct tMidiMessage> _sorted;
+    std::vector<unsigned int> _batchOrder;
+    size_t _batchSize = 0;
+
+    // When each collected message was due at the sink, which is the sink's
+    // lookahead before its time for what RunNotes plays ahead (but not before
+    // the grid started), and its time for what is sent right away
+    std::vector<long long> _batchHandover;
+    long long _sendAhead = 0;
+
+    void Collect(
+        long long time,
+        const unsigned char *message,
+        size_t size);
+};
+
+#endif // ENGINE_H
@@ -0,0 +1,50 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <atomic>
+
+struct tHistogramSummary
+{
+    long long _count = 0;
+    long long _p50 = 0;
+    long long _p99 = 0;
+    long long _p999 = 0;
+    long long _max = 0;
+};
+
+// Histogram of durations in nanoseconds for one writer thread and any number
+// of readers. Buckets are a microsecond wide up to 8 us and then eight per
+// power of two, so percentiles are within 12.5% up to about 20 minutes.
+// Record never locks or allocates.
+class Histogram
+{
+public:
+    static const int SubBuckets = 8;
+    static const int Buckets = SubBuckets + 28 * SubBuckets;
+
+    void Record(
+        long long nanoseconds);
+
+    long long Count() const;
+
+    long long Max() const;
+
+    // Upper bound of the bucket the given fraction of the values falls in
+    long long Percentile(
+        double fraction) const;
+
+    tHistogramSummary Summary() const;
+
+private:
+    std::atomic<unsigned int> _buckets[Buckets] = {};
+    std::atomic<long long> _count{0};
+    std::atomic<long long> _max{0};
+
+    static int Bucket(
+        long long nanoseconds);
+
+    static long long BucketLimit(
+        int bucket);
+};
+
+#endif // HISTOGRAM_H
@@ -0,0 +1,97 @@
+#ifndef JACKSINK_H
+#define JACKSINK_H
+
+#include <midisink.hpp>
+#include <spscqueue.hpp>
+
+#include <atomic>
+#include <jack/jack.h>
+#include <jack/midiport.h>
+#include <jack/transport.h>
+
+// Output through a JACK MIDI port. The engine hands messages ahead of time,
+// the process callback writes every message in the period it falls in at the
+// frame offset of its due time, so notes line up with the audio to the
+// sample. The JACK transport drives tempo, position and play state.
+class JackSink : public MidiSink
+{
+public:
+    JackSink();
+
+    virtual ~JackSink();
+
+    bool Init() override;
+
+    std::vector<std::string> PortNames() override;
+
+    void OpenPort(
+        unsigned int port) override;
+
+    void ClosePort() override;
+
+    long long Lookahead() const override;
+
+    void Send(
+        long long time,
+        const unsigned char *message,
+        size_t size) override;
+
+    void DropPending() override;
+
+    bool PollTransport(
+        struct tExternalTransport &transport) override;
+
+    // Messages lost because the process callback fell behind, safe to read
+    // from any thread
+    long long Dropped() const;
+
+private:
+    struct tQueuedMessage
+    {
+        long long _time = 0;
+        unsigned int _generation = 0;
+        unsigned char _data[3] = {0, 0, 0};
+        unsigned char _size = 0;
+    };
+
+    jack_client_t *_client = nullptr;
+    jack_port_t *_port = nullptr;
+    long long _lookahead = 0;
+
+    // Engine clock minus JACK's microsecond clock, in nanoseconds
+    long long _clockOffset = 0;
+
+    // Written by the engine thread, read by the process callback
+    static const size_t QueueCapacity = 4096;
+    SpscQueue<tQueuedMessage, QueueCapacity> _messages;
+    std::atomic<long long> _dropped{0};
+
+    // DropPending starts a new generation, queued messages of an older
+    // generation are dropped unless they are note-offs
+    std::atomic<unsigned int> _generation{0};
+
+    // A message that is due after the current period waits here for the
+    // next one, only touched by the process callback
+    tQueuedMessage _held;
+    bool _holding = false;
+
+    // Transport changes found by the process callback, latest one wins
+    SpscQueue<tExternalTransport, 16> _transportChanges;
+    tExternalTransport _transport;
+
+    // Destinations in PortNames order, and the one we are connected to
+    std::vector<std::string> _destinations;
+    std::string _connection;
+
+    static int ProcessCallback(
+        jack_nframes_t frames,
+        void *arg);
+
+    void Process(
+        jack_nframes_t frames);
+
+    void FollowTransport(
+        long long cycleStart);
+};
+
+#endif // JACKSINK_H
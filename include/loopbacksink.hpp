@@ -0,0 +1,48 @@
+#ifndef LOOPBACKSINK_H
+#define LOOPBACKSINK_H
+
+#include <midisink.hpp>
+#include <spscqueue.hpp>
+
+#include <atomic>
+
+// Hands every message back within the process instead of to a port, so a
+// test can play through the running engine and read what came out. The
+// engine thread sends, one other thread receives. With a lookahead it
+// behaves like a scheduling sink and gets messages early.
+class LoopbackSink : public MidiSink
+{
+public:
+    LoopbackSink(
+        long long lookahead = 0);
+
+    bool Init() override;
+
+    std::vector<std::string> PortNames() override;
+
+    void OpenPort(
+        unsigned int port) override;
+
+    void ClosePort() override;
+
+    long long Lookahead() const override;
+
+    void Send(
+        long long time,
+        const unsigned char *message,
+        size_t size) override;
+
+    // Next message in the order they were sent, false when there is none
+    bool Receive(
+        struct tMidiMessage &message);
+
+    // Messages lost because nobody received them in time
+    long long Dropped() const;
+
+private:
+    long long _lookahead;
+    SpscQueue<tMidiMessage, 4096> _messages;
+    std::atomic<long long> _dropped{0};
+};
+
+#endif // LOOPBACKSINK_H
@@ -0,0 +1,51 @@
+#ifndef MIDICLOCKFOLLOWER_H
+#define MIDICLOCKFOLLOWER_H
+
+#include <cstddef>
+
+#include <midisink.hpp>
+
+// Follows incoming MIDI clock (24 pulses per beat) with Start, Stop,
+// Continue and Song Position Pointer. A second order phase-locked loop
+// smooths the jitter of the incoming pulses into a stable pulse period and
+// phase, the engine is realigned to it once every beat.
+class MidiClockFollower
+{
+public:
+    static const int PulsesPerBeat = 24;
+
+    // Takes one realtime or system common message, returns true when the
+    // engine has to follow the transport it filled in
+    bool Receive(
+        long long time,
+        const unsigned char *message,
+        size_t size,
+        struct tExternalTransport &transport);
+
+    void Reset();
+
+    // Tempo of the incoming clock in thousandths of a BPM, 0 until locked
+    long long MilliBpm() const;
+
+private:
+    bool _rolling = false;
+
+    // Start and Continue begin playing on the next pulse
+    bool _waitingForPulse = false;
+
+    // Position of the next pulse, and where Continue picks up
+    long long _pulse = 0;
+    long long _songPosition = 0;
+
+    // Loop state in nanoseconds: the filtered pulse period and the time
+    // the next pulse is expected at
+    double _period = 0.0;
+    double _expected = 0.0;
+    long long _lastPulse = 0;
+
+    // Filtered time of the pulse that was just received
+    double Pulse(
+        long long time);
+};
+
+#endif // MIDICLOCKFOLLOWER_H
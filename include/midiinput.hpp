@@ -0,0 +1,49 @@
+#ifndef MIDIINPUT_H
+#define MIDIINPUT_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <RtMidi.h>
+#include <clock.hpp>
+#include <engine.hpp>
+
+// Feeds a MIDI input port into the engine. RtMidi calls back on its own
+// thread as soon as a message comes in, the message is timestamped there
+// and queued for the engine without waiting for the UI.
+class MidiInput
+{
+public:
+    MidiInput(
+        Engine &engine,
+        RtMidi::Api api = RtMidi::UNSPECIFIED);
+
+    virtual ~MidiInput();
+
+    bool Init();
+
+    std::vector<std::string> PortNames();
+
+    void OpenPort(
+        unsigned int port);
+
+    void ClosePort();
+
+    // Messages the engine could not take because its input queue was full
+    long long Dropped() const;
+
+private:
+    Engine &_engine;
+    RtMidi::Api _api;
+    RtMidiIn *_midiin = nullptr;
+    SteadyClock _clock;
+    std::atomic<long long> _dropped{0};
+
+    static void Received(
+        double deltaTime,
+        std::vector<unsigned char> *message,
+        void *userData);
+};
+
+#endif // MIDIINPUT_H
@@ -0,0 +1,130 @@
+#ifndef MIDISINK_H
+#define MIDISINK_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <RtMidi.h>
+
+// Position of an external timeline, for sinks that have one the engine can
+// follow instead of its own tempo and play state
+struct tExternalTransport
+{
+    bool _rolling = false;
+
+    // Thousandths of a BPM, 0 when the timeline has no tempo
+    long long _milliBpm = 0;
+
+    // Beat number _beat of the timeline falls at _beatTime on the engine
+    // clock
+    long long _beat = 0;
+    long long _beatTime = 0;
+};
+
+// One timestamped message, channel and system realtime messages are never
+// longer than three bytes
+struct tMidiMessage
+{
+    long long _time = 0;
+    unsigned char _data[3] = {0, 0, 0};
+    unsigned char _size = 0;
+};
+
+// Where the engine sends its messages. Every message carries the time it is
+// due at, in nanoseconds on the engine clock, which is in the past when the
+// engine is late. A sink that can schedule
+// (Lookahead() > 0) is handed messages up to that far ahead and delivers
+// them on time itself, other sinks get every message when it is due and
+// send it right away.
+class MidiSink
+{
+public:
+    typedef void (*TransportCallback)(
+        void *arg);
+
+    virtual ~MidiSink();
+
+    virtual bool Init() = 0;
+
+    virtual std::vector<std::string> PortNames() = 0;
+
+    virtual void OpenPort(
+        unsigned int port) = 0;
+
+    virtual void ClosePort() = 0;
+
+    virtual long long Lookahead() const;
+
+    virtual void Send(
+        long long time,
+        const unsigned char *message,
+        size_t size) = 0;
+
+    // Hands over messages in the order given. By default every one of them
+    // goes through Send, a sink that can submit several at once overrides it.
+    virtual void SendBatch(
+        const struct tMidiMessage *messages,
+        size_t count);
+
+    // Forgets messages that were scheduled but not delivered yet, note-offs
+    // excepted, so stopping does not leave notes behind that start later
+    virtual void DropPending();
+
+    // Fills in the external transport and returns true when it changed
+    // since the last call, sinks without a timeline always return false
+    virtual bool PollTransport(
+        struct tExternalTransport &transport);
+
+    // Called by a sink with a timeline, from any thread, when PollTransport
+    // has a change, so the engine does not have to poll for it
+    virtual void SetTransportCallback(
+        TransportCallback callback,
+        void *arg);
+
+protected:
+    void TransportChanged();
+
+private:
+    std::atomic<TransportCallback> _transportCallback{nullptr};
+    std::atomic<void *> _transportCallbackArg{nullptr};
+};
+
+// Sends through RtMidi, using whatever API it was built for
+class RtMidiSink : public MidiSink
+{
+public:
+    RtMidiSink(
+        RtMidi::Api api = RtMidi::UNSPECIFIED);
+
+    virtual ~RtMidiSink();
+
+    bool Init() override;
+
+    std::vector<std::string> PortNames() override;
+
+    void OpenPort(
+        unsigned int port) override;
+
+    void ClosePort() override;
+
+    void Send(
+        long long time,
+        const unsigned char *message,
+        size_t size) override;
+
+private:
+    RtMidi::Api _api;
+    RtMidiOut *_midiout = nullptr;
+};
+
+// Names of the backends this build has, the first one is the default
+std::vector<std::string> MidiSinkBackends();
+
+// Creates the sink for a backend name from MidiSinkBackends, or nullptr when
+// this build does not have it. "capture:<file>" captures to that file. The
+// sink still has to be initialized.
+MidiSink *CreateMidiSink(
+    const std::string &backend);
+
+#endif // MIDISINK_H
@@ -0,0 +1,95 @@
+#ifndef NOTEBITMAP_H
+#define NOTEBITMAP_H
+
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// One bit for each of the 128 MIDI notes. Test/Set/Clear are O(1) and the
+// set notes are walked from low to high with count-trailing-zeros.
+struct NoteBitmap
+{
+    uint64_t _bits[2] = {0, 0};
+
+    bool Test(
+        unsigned int note) const
+    {
+        return note < 128 && (_bits[note >> 6] & (uint64_t(1) << (note & 63))) != 0;
+    }
+
+    void Set(
+        unsigned int note)
+    {
+        if (note < 128)
+        {
+            _bits[note >> 6] |= uint64_t(1) << (note & 63);
+        }
+    }
+
+    void Clear(
+        unsigned int note)
+    {
+        if (note < 128)
+        {
+            _bits[note >> 6] &= ~(uint64_t(1) << (note & 63));
+        }
+    }
+
+    void ClearAll()
+    {
+        _bits[0] = 0;
+        _bits[1] = 0;
+    }
+
+    bool Empty() const
+    {
+        return (_bits[0] | _bits[1]) == 0;
+    }
+
+    int Count() const
+    {
+        return PopCount(_bits[0]) + PopCount(_bits[1]);
+    }
+
+    // Calls f(note) for every set note, lowest note first
+    template <class F>
+    void ForEach(
+        F f) const
+    {
+        for (unsigned int word = 0; word < 2; word++)
+        {
+            auto bits = _bits[word];
+            while (bits != 0)
+            {
+                f((unsigned char)((word << 6) + TrailingZeros(bits)));
+                bits &= bits - 1;
+            }
+        }
+    }
+
+    static int PopCount(
+        uint64_t bits)
+    {
+#ifdef _MSC_VER
+        return int(__popcnt64(bits));
+#else
+        return __builtin_popcountll(bits);
+#endif
+    }
+
+    static unsigned int TrailingZeros(
+        uint64_t bits)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, bits);
+        return index;
+#else
+        return unsigned(__builtin_ctzll(bits));
+#endif
+    }
+};
+
+#endif // NOTEBITMAP_H
@@ -0,0 +1,41 @@
+#ifndef NULLSINK_H
+#define NULLSINK_H
+
+#include <midisink.hpp>
+
+#include <atomic>
+
+// Throws every message away and only counts them, so the engine can be
+// measured without the cost of a driver
+class NullSink : public MidiSink
+{
+public:
+    bool Init() override;
+
+    std::vector<std::string> PortNames() override;
+
+    void OpenPort(
+        unsigned int port) override;
+
+    void ClosePort() override;
+
+    void Send(
+        long long time,
+        const unsigned char *message,
+        size_t size) override;
+
+    void SendBatch(
+        const struct tMidiMessage *messages,
+        size_t count) override;
+
+    // Safe to read from any thread
+    long long Messages() const;
+
+    long long Bytes() const;
+
+private:
+    std::atomic<long long> _messages{0};
+    std::atomic<long long> _bytes{0};
+};
+
+#endif // NULLSINK_H
@@ -0,0 +1,77 @@
+#ifndef OFFLINERENDER_H
+#define OFFLINERENDER_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <clock.hpp>
+#include <engine.hpp>
+#include <session.hpp>
+
+struct tRenderedEvent
+{
+    long long _time;
+    unsigned char _data[3];
+};
+
+// Runs the engine on a virtual clock, as fast as the CPU allows, and keeps
+// everything it plays. The stepping is the engine's own RunNotes and the
+// events are taken from its sink after every tick's Flush, so they are
+// exactly what live playback sends, in the same order, and with the
+// session's seed every run gives the same list.
+class OfflineRenderer : public Engine
+{
+public:
+    static const int TicksPerQuarter = 960;
+
+    OfflineRenderer();
+
+    void Render(
+        const struct tSession &session,
+        int bars);
+
+    const std::vector<tRenderedEvent> &Events() const;
+
+    // One track per MIDI channel in use, track 0 holds tempo and meter
+    bool WriteSmf(
+        const std::string &path,
+        std::string &error) const;
+
+    // One event per line, "<nanoseconds> <status> <data1> <data2>" in hex,
+    // for comparing against a golden list
+    void WriteEventList(
+        std::ostream &out) const;
+
+private:
+    // Keeps the channel messages of every batch, there are no ports
+    class EventSink : public MidiSink
+    {
+    public:
+        EventSink(
+            std::vector<tRenderedEvent> &events);
+
+        bool Init() override;
+
+        std::vector<std::string> PortNames() override;
+
+        void OpenPort(
+            unsigned int port) override;
+
+        void ClosePort() override;
+
+        void Send(
+            long long time,
+            const unsigned char *message,
+            size_t size) override;
+
+    private:
+        std::vector<tRenderedEvent> &_events;
+    };
+
+    VirtualClock _virtualClock;
+    std::vector<tRenderedEvent> _events;
+    EventSink _eventSink{_events};
+};
+
+#endif // OFFLINERENDER_H
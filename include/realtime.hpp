@@ -0,0 +1,58 @@
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <cstddef>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class SchedulingPolicies
+{
+    Default,
+    Fifo,
+    RoundRobin,
+};
+
+// How the engine thread runs. Everything is off by default, most of it
+// needs permissions a normal user does not have.
+struct tRealtimeOptions
+{
+    SchedulingPolicies _policy = SchedulingPolicies::Default;
+    int _priority = 70;
+
+    // Core to pin the thread to, -1 to let the scheduler pick
+    int _cpu = -1;
+
+    // Locks all current and future memory of the process with mlockall
+    bool _lockMemory = false;
+
+    // Bytes of stack the thread touches before it starts, so it does not
+    // page fault on a deep call later
+    size_t _stackPrefault = 0;
+
+    // Nanoseconds before an event the thread stops sleeping and spins. The
+    // core is busy for that long before every event, in return the event
+    // does not wait for a late wake-up.
+    long long _spinWindow = 0;
+};
+
+// Takes one option from the command line at args[i], moving i past its
+// value. Returns false when args[i] is not a realtime option.
+bool ParseRealtimeOption(
+    const std::vector<std::string> &args,
+    size_t &i,
+    struct tRealtimeOptions &options);
+
+const char *RealtimeUsage();
+
+// Applies policy, priority, CPU and memory locking to a running thread.
+// Returns a description of every option that could not be applied.
+std::vector<std::string> ApplyRealtime(
+    std::thread &thread,
+    const struct tRealtimeOptions &options);
+
+// Called on the thread itself
+void PrefaultStack(
+    size_t bytes);
+
+#endif // REALTIME_H
@@ -0,0 +1,62 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <string>
+#include <vector>
+
+#include <engine.hpp>
+
+struct tSessionChannel
+{
+    std::string _name;
+    unsigned char _channel = 0;
+    int _arpMode = ArpModes::Up;
+    unsigned char _velocity = 100;
+    float _noteLength = 0.4f;
+    std::vector<unsigned char> _notes;
+};
+
+// Everything needed to start the engine without the UI. A session file is
+// plain text, one setting per line, '#' starts a comment:
+//
+//     bpm 127.3
+//     port 1
+//     seed 42
+//     channel Bass
+//     midi 2
+//     mode up
+//     velocity 100
+//     length 0.4
+//     notes 36 43 48
+//
+// Each "channel" line starts a new channel, the lines after it apply to
+// that channel. Midi channels are 1-16 like on the hardware. The seed makes
+// Random mode repeat the same notes every run.
+struct tSession
+{
+    float _bpm = 100.0f;
+    int _port = -1;
+    int _seed = 1;
+    std::vector<struct tSessionChannel> _channels;
+};
+
+bool LoadSession(
+    const std::string &path,
+    struct tSession &session,
+    std::string &error);
+
+bool ParseArpMode(
+    const std::string &name,
+    int &arpMode);
+
+// The commands that set up the session's channels and tempo on an empty
+// engine, the transport is left alone.
+std::vector<tEngineCommand> SessionCommands(
+    const struct tSession &session);
+
+// Posts the session's commands, the engine has to be running.
+void PostSession(
+    Engine &engine,
+    const struct tSession &session);
+
+#endif // SESSION_H
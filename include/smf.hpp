@@ -0,0 +1,51 @@
+#ifndef SMF_H
+#define SMF_H
+
+#include <string>
+#include <vector>
+
+// Collects events per track and writes them as a format 1 Standard MIDI
+// File. Track 0 holds the tempo and time signature.
+class SmfWriter
+{
+public:
+    SmfWriter(
+        int ticksPerQuarter);
+
+    // Adds a track and returns its index, the first track added is 1
+    size_t AddTrack(
+        const std::string &name);
+
+    void SetTempo(
+        long long milliBpm);
+
+    void AddEvent(
+        size_t track,
+        long long tick,
+        unsigned char status,
+        unsigned char data1,
+        unsigned char data2);
+
+    bool Write(
+        const std::string &path,
+        std::string &error) const;
+
+private:
+    struct tEvent
+    {
+        long long _tick;
+        unsigned char _data[3];
+    };
+
+    struct tTrack
+    {
+        std::string _name;
+        std::vector<tEvent> _events;
+    };
+
+    int _ticksPerQuarter;
+    long long _milliBpm = 120000;
+    std::vector<tTrack> _tracks;
+};
+
+#endif // SMF_H
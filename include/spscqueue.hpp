@@ -0,0 +1,67 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Bounded queue for exactly one producer thread and one consumer thread.
+// Push and Pop never lock or allocate, Push fails when the queue is full.
+template <class T, size_t Capacity>
+class SpscQueue
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    bool Push(
+        const T &item)
+    {
+        auto head = _head.load(std::memory_order_relaxed);
+
+        if (head - _tail.load(std::memory_order_acquire) == Capacity)
+        {
+            return false;
+        }
+
+        _items[head & (Capacity - 1)] = item;
+        _head.store(head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    bool Pop(
+        T &item)
+    {
+        auto tail = _tail.load(std::memory_order_relaxed);
+
+        if (tail == _head.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        item = _items[tail & (Capacity - 1)];
+        _tail.store(tail + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    bool Empty() const
+    {
+        return _tail.load(std::memory_order_acquire) == _head.load(std::memory_order_acquire);
+    }
+
+    // Exact for the producer, the consumer may only have taken more since
+    size_t Size() const
+    {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+private:
+    std::array<T, Capacity> _items;
+
+    // Producer and consumer indices live on their own cache line
+    alignas(64) std::atomic<size_t> _head{0};
+    alignas(64) std::atomic<size_t> _tail{0};
+};
+
+#endif // SPSCQUEUE_H
@@ -0,0 +1,108 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include <clock.hpp>
+#include <spscqueue.hpp>
+
+// Threads that record trace events, each one has its own queue
+enum TraceTracks
+{
+    UiTrack = 0,
+    EngineTrack = 1,
+    TrackCount = 2,
+};
+
+struct tTraceEvent
+{
+    // Only string literals, the writer reads them long after they were recorded
+    const char *_name = nullptr;
+    long long _start = 0;
+    long long _end = 0;
+};
+
+// Writes timed slices to a Chrome trace JSON file, which chrome://tracing and
+// ui.perfetto.dev can open. Record never locks, allocates or touches the file,
+// a writer thread drains the queues a few times per second. When a queue is
+// full the event is dropped and counted.
+class Tracer
+{
+public:
+    Tracer();
+    ~Tracer();
+
+    bool Open(
+        const std::string &path);
+
+    void Close();
+
+    bool Enabled() const;
+
+    // Only called by the thread that owns the track
+    void Record(
+        int track,
+        const char *name,
+        long long start,
+        long long end);
+
+    long long Now() const;
+
+    long long Dropped() const;
+
+private:
+    SpscQueue<tTraceEvent, 8192> _tracks[TrackCount];
+    std::atomic<bool> _enabled{false};
+    std::atomic<bool> _running{false};
+    std::atomic<long long> _dropped{0};
+    std::thread _writer;
+    std::ofstream _file;
+    SteadyClock _clock;
+    long long _origin = 0;
+
+    void Write();
+
+    void Drain();
+};
+
+// Records the time between its construction and destruction as one slice,
+// costs next to nothing when there is no tracer or it is not open
+class TraceScope
+{
+public:
+    TraceScope(
+        Tracer *tracer,
+        int track,
+        const char *name)
+        : _tracer(tracer != nullptr && tracer->Enabled() ? tracer : nullptr),
+          _track(track),
+          _name(name)
+    {
+        if (_tracer != nullptr)
+        {
+            _start = _tracer->Now();
+        }
+    }
+
+    ~TraceScope()
+    {
+        if (_tracer != nullptr)
+        {
+            _tracer->Record(_track, _name, _start, _tracer->Now());
+        }
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    Tracer *_tracer;
+    int _track;
+    const char *_name;
+    long long _start = 0;
+};
+
+#endif // TRACER_H
@@ -0,0 +1,43 @@
+#ifndef WAKETIMER_H
+#define WAKETIMER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+// Lets one thread sleep until an absolute time on the steady clock, or until
+// another thread wakes it up. On Linux this is a timerfd armed with an
+// absolute deadline and an eventfd, both waited on with poll, elsewhere a
+// condition variable. A Wake that comes before the sleep is not lost.
+class WakeTimer
+{
+public:
+    WakeTimer();
+    ~WakeTimer();
+
+    // Deadline in nanoseconds on the steady clock
+    void SleepUntil(
+        long long deadline);
+
+    // Safe to call from any thread
+    void Wake();
+
+    // Busy waits until the deadline unless woken up first, for the last
+    // part of a wait where waking up from a sleep would be too late
+    void SpinUntil(
+        long long deadline);
+
+private:
+#ifdef __linux__
+    int _timer = -1;
+    int _event = -1;
+
+    void ClearWake();
+#endif
+
+    std::mutex _lock;
+    std::condition_variable _wakeup;
+    std::atomic<bool> _woken{false};
+};
+
+#endif // WAKETIMER_H
@@ -0,0 +1,78 @@
+#include <allocationguard.hpp>
+
+#ifdef ARP_CHECK_ALLOCATIONS
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+static thread_local int noAllocationDepth = 0;
+
+NoAllocationScope::NoAllocationScope()
+{
+    noAllocationDepth++;
+}
+
+NoAllocationScope::~NoAllocationScope()
+{
+    noAllocationDepth--;
+}
+
+static void *CheckedAllocate(
+    std::size_t size)
+{
+    if (noAllocationDepth > 0)
+    {
+        std::fprintf(stderr, "heap allocation of %zu bytes on the engine path\n", size);
+        assert(false && "heap allocation on the engine path");
+    }
+
+    void *p = std::malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+
+    return p;
+}
+
+void *operator new(
+    std::size_t size)
+{
+    return CheckedAllocate(size);
+}
+
+void *operator new[](
+    std::size_t size)
+{
+    return CheckedAllocate(size);
+}
+
+void operator delete(
+    void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](
+    void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(
+    void *p,
+    std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](
+    void *p,
+    std::size_t) noexcept
+{
+    std::free(p);
+}
+
+#endif // ARP_CHECK_ALLOCATIONS
@@ -0,0 +1,284 @@
+#include <alsaseqsink.hpp>
+#include <clock.hpp>
+
+#include <iostream>
+
+// The kernel takes the queue timer resolution as a frequency in Hz, clamps
+// it to 10 to 6250 and fires the timer that often. Scheduled events go out
+// on those interrupts, so the highest it allows gives 160 us steps.
+const unsigned int QueueTimerFrequency = 6250;
+
+AlsaSeqSink::AlsaSeqSink(
+    long long lookahead)
+    : _lookahead(lookahead)
+{}
+
+AlsaSeqSink::~AlsaSeqSink()
+{
+    if (_seq == nullptr)
+    {
+        return;
+    }
+
+    ClosePort();
+
+    if (_queue >= 0)
+    {
+        snd_seq_stop_queue(_seq, _queue, nullptr);
+        snd_seq_drain_output(_seq);
+        snd_seq_free_queue(_seq, _queue);
+    }
+
+    if (_encoder != nullptr)
+    {
+        snd_midi_event_free(_encoder);
+    }
+
+    snd_seq_close(_seq);
+    _seq = nullptr;
+}
+
+bool AlsaSeqSink::Init()
+{
+    auto result = snd_seq_open(&_seq, "default", SND_SEQ_OPEN_OUTPUT, 0);
+    if (result < 0)
+    {
+        std::cerr << "Cannot open the ALSA sequencer: " << snd_strerror(result) << std::endl;
+        _seq = nullptr;
+        return false;
+    }
+
+    snd_seq_set_client_name(_seq, "arp");
+
+    _port = snd_seq_create_simple_port(
+        _seq,
+        "arp out",
+        SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ,
+        SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_APPLICATION);
+    if (_port < 0)
+    {
+        std::cerr << "Cannot create an ALSA sequencer port: " << snd_strerror(_port) << std::endl;
+        return false;
+    }
+
+    _queue = snd_seq_alloc_named_queue(_seq, "arp");
+    if (_queue < 0)
+    {
+        std::cerr << "Cannot allocate an ALSA sequencer queue: " << snd_strerror(_queue) << std::endl;
+        return false;
+    }
+
+    // Prefer the high resolution timer over the system timer, which only
+    // ticks at the kernel HZ
+    snd_seq_queue_timer_t *timer;
+    snd_seq_queue_timer_alloca(&timer);
+    if (snd_seq_get_queue_timer(_seq, _queue, timer) == 0)
+    {
+        snd_timer_id_t *id;
+        snd_timer_id_alloca(&id);
+        snd_timer_id_set_class(id, SND_TIMER_CLASS_GLOBAL);
+        snd_timer_id_set_sclass(id, SND_TIMER_SCLASS_NONE);
+        snd_timer_id_set_card(id, -1);
+        snd_timer_id_set_device(id, SND_TIMER_GLOBAL_HRTIMER);
+        snd_timer_id_set_subdevice(id, 0);
+        snd_seq_queue_timer_set_id(timer, id);
+        snd_seq_queue_timer_set_resolution(timer, QueueTimerFrequency);
+        snd_seq_set_queue_timer(_seq, _queue, timer);
+    }
+
+    if (snd_midi_event_new(16, &_encoder) < 0)
+    {
+        std::cerr << "Cannot create an ALSA midi encoder" << std::endl;
+        return false;
+    }
+    snd_midi_event_no_status(_encoder, 1);
+
+    snd_seq_start_queue(_seq, _queue, nullptr);
+    snd_seq_drain_output(_seq);
+    _queueStart = SteadyClock().Now() - QueueTime();
+
+    return true;
+}
+
+std::vector<std::string> AlsaSeqSink::PortNames()
+{
+    std::vector<std::string> names;
+    _destinations.clear();
+
+    if (_seq == nullptr)
+    {
+        return names;
+    }
+
+    snd_seq_client_info_t *client;
+    snd_seq_port_info_t *port;
+    snd_seq_client_info_alloca(&client);
+    snd_seq_port_info_alloca(&port);
+
+    const unsigned int wanted = SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE;
+
+    snd_seq_client_info_set_client(client, -1);
+    while (snd_seq_query_next_client(_seq, client) >= 0)
+    {
+        auto clientId = snd_seq_client_info_get_client(client);
+        if (clientId == snd_seq_client_id(_seq))
+        {
+            continue;
+        }
+
+        snd_seq_port_info_set_client(port, clientId);
+        snd_seq_port_info_set_port(port, -1);
+        while (snd_seq_query_next_port(_seq, port) >= 0)
+        {
+            if ((snd_seq_port_info_get_capability(port) & wanted) != wanted)
+            {
+                continue;
+            }
+
+            _destinations.push_back(*snd_seq_port_info_get_addr(port));
+            names.push_back(std::string(snd_seq_client_info_get_name(client)) + ":" + snd_seq_port_info_get_name(port));
+        }
+    }
+
+    return names;
+}
+
+void AlsaSeqSink::OpenPort(
+    unsigned int port)
+{
+    if (_seq == nullptr)
+    {
+        return;
+    }
+
+    if (_destinations.empty())
+    {
+        PortNames();
+    }
+
+    if (port >= _destinations.size())
+    {
+        std::cerr << "No ALSA sequencer port " << port << std::endl;
+        return;
+    }
+
+    ClosePort();
+
+    auto destination = _destinations[port];
+    auto result = snd_seq_connect_to(_seq, _port, destination.client, destination.port);
+    if (result < 0)
+    {
+        std::cerr << "Cannot connect to ALSA sequencer port " << port << ": " << snd_strerror(result) << std::endl;
+        return;
+    }
+
+    _connection = destination;
+    _connected = true;
+}
+
+void AlsaSeqSink::ClosePort()
+{
+    if (!_connected)
+    {
+        return;
+    }
+
+    snd_seq_disconnect_to(_seq, _port, _connection.client, _connection.port);
+    _connected = false;
+}
+
+long long AlsaSeqSink::Lookahead() const
+{
+    return _lookahead;
+}
+
+void AlsaSeqSink::Send(
+    long long time,
+    const unsigned char *message,
+    size_t size)
+{
+    if (!_connected)
+    {
+        return;
+    }
+
+    Output(time, message, size);
+    snd_seq_drain_output(_seq);
+}
+
+void AlsaSeqSink::SendBatch(
+    const struct tMidiMessage *messages,
+    size_t count)
+{
+    if (!_connected || count == 0)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        Output(messages[i]._time, messages[i]._data, messages[i]._size);
+    }
+    snd_seq_drain_output(_seq);
+}
+
+void AlsaSeqSink::Output(
+    long long time,
+    const unsigned char *message,
+    size_t size)
+{
+    snd_seq_event_t ev;
+    snd_seq_ev_clear(&ev);
+
+    snd_midi_event_reset_encode(_encoder);
+    if (snd_midi_event_encode(_encoder, message, long(size), &ev) <= 0 || ev.type == SND_SEQ_EVENT_NONE)
+    {
+        return;
+    }
+
+    snd_seq_ev_set_source(&ev, _port);
+    snd_seq_ev_set_subs(&ev);
+
+    // Late messages go out at once, the queue never runs backwards
+    auto queueTime = time - _queueStart;
+    if (queueTime < 0)
+    {
+        queueTime = 0;
+    }
+
+    snd_seq_real_time_t due;
+    due.tv_sec = (unsigned int)(queueTime / 1000000000LL);
+    due.tv_nsec = (unsigned int)(queueTime % 1000000000LL);
+    snd_seq_ev_schedule_real(&ev, _queue, 0, &due);
+
+    snd_seq_event_output(_seq, &ev);
+}
+
+void AlsaSeqSink::DropPending()
+{
+    if (_seq == nullptr)
+    {
+        return;
+    }
+
+    snd_seq_remove_events_t *remove;
+    snd_seq_remove_events_alloca(&remove);
+    snd_seq_remove_events_set_queue(remove, _queue);
+    snd_seq_remove_events_set_condition(remove, SND_SEQ_REMOVE_OUTPUT | SND_SEQ_REMOVE_IGNORE_OFF);
+    snd_seq_remove_events(_seq, remove);
+}
+
+long long AlsaSeqSink::QueueTime() const
+{
+    snd_seq_queue_status_t *status;
+    snd_seq_queue_status_alloca(&status);
+
+    if (snd_seq_get_queue_status(_seq, _queue, status) < 0)
+    {
+        return 0;
+    }
+
+    auto time = snd_seq_queue_status_get_real_time(status);
+
+    return (long long)time->tv_sec * 1000000000LL + time->tv_nsec;
+}
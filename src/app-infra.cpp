@@ -6,6 +6,7 @@
 #include <GLFW/glfw3.h>
 #include <backends/imgui_impl_glfw.h>
 #include <backends/imgui_impl_opengl3.h>
+#include <algorithm>
 #include <iostream>
 #include <memory>
 
@@ -80,6 +81,25 @@ void OpenGLMessageCallback(
               << "\n";
 }
 
+static App *WindowApp(
+    GLFWwindow *window)
+{
+    return reinterpret_cast<App *>(glfwGetWindowUserPointer(window));
+}
+
+// Installed before the ImGui backend, which calls them after its own
+static void InstallInputCallbacks(
+    GLFWwindow *window)
+{
+    glfwSetCursorPosCallback(window, [](GLFWwindow *w, double, double) { WindowApp(w)->Invalidate(); });
+    glfwSetMouseButtonCallback(window, [](GLFWwindow *w, int, int, int) { WindowApp(w)->Invalidate(); });
+    glfwSetScrollCallback(window, [](GLFWwindow *w, double, double) { WindowApp(w)->Invalidate(); });
+    glfwSetKeyCallback(window, [](GLFWwindow *w, int, int, int, int) { WindowApp(w)->Invalidate(); });
+    glfwSetCharCallback(window, [](GLFWwindow *w, unsigned int) { WindowApp(w)->Invalidate(); });
+    glfwSetWindowFocusCallback(window, [](GLFWwindow *w, int) { WindowApp(w)->Invalidate(); });
+    glfwSetWindowRefreshCallback(window, [](GLFWwindow *w) { WindowApp(w)->Invalidate(); });
+}
+
 bool App::Init()
 {
     if (glfwInit() == GLFW_FALSE)
@@ -128,6 +148,7 @@ bool App::Init()
     //ImGui::StyleColorsClassic();
 
     // Setup Platform/Renderer backends
+    InstallInputCallbacks(window);
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 150");
 
@@ -170,13 +191,41 @@ int App::Run()
 
     glfwSetWindowSizeCallback(windowHandle->window, window_resize);
 
+    auto lastFrame = glfwGetTime();
+    Invalidate();
+
     while (glfwWindowShouldClose(windowHandle->window) == 0 && running)
     {
-#if ONLY_RENDER_ON_MESSAGE
-        glfwWaitEvents();
-#else
-        glfwPollEvents();
-#endif
+        if (glfwGetWindowAttrib(windowHandle->window, GLFW_ICONIFIED) != 0)
+        {
+            // Nothing to see, the engine plays on in its own thread
+            glfwWaitEvents();
+            Invalidate();
+            continue;
+        }
+
+        {
+            TraceScope trace(&_tracer, UiTrack, "Wait events");
+            glfwPollEvents();
+
+            // Draw at the full rate while the UI or the playhead moves and
+            // at the idle rate otherwise, which keeps the stats fresh. The
+            // engine cannot wake us, so it is looked at once a frame.
+            for (;;)
+            {
+                auto now = glfwGetTime();
+                auto next = lastFrame + 1.0 / (NeedsFrame() ? _maxFps : _idleFps);
+                if (now >= next || glfwWindowShouldClose(windowHandle->window) != 0)
+                {
+                    break;
+                }
+                glfwWaitEventsTimeout(std::min(next - now, 1.0 / _maxFps));
+            }
+            lastFrame = glfwGetTime();
+        }
+
+        TraceScope frame(&_tracer, UiTrack, "Frame");
+
         glfwMakeContextCurrent(windowHandle->window);
 
         // Start the Dear ImGui frame
@@ -184,15 +233,29 @@ int App::Run()
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
 
-        OnFrame();
-
-        ImGui::Render();
-
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-
-        glfwSwapBuffers(windowHandle->window);
+        {
+            TraceScope trace(&_tracer, UiTrack, "OnFrame");
+            OnFrame();
+        }
+
+        {
+            TraceScope trace(&_tracer, UiTrack, "ImGui::Render");
+            ImGui::Render();
+        }
+
+        {
+            TraceScope trace(&_tracer, UiTrack, "RenderDrawData");
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
+
+        {
+            TraceScope trace(&_tracer, UiTrack, "SwapBuffers");
+            glfwSwapBuffers(windowHandle->window);
+        }
     }
 
+    OnExit();
+
     ClearWindowHandle();
 
     return 0;
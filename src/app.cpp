@@ -1,9 +1,11 @@
 
-#include <algorithm>
 #include <app.hpp>
-#include <chrono>
 #include <glad/glad.h>
 #include <imgui.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
 #include <sstream>
 
 #include "imgui_knob.h"
@@ -24,42 +26,88 @@ const int firstKeyNoteNumber = 24;
 
 void App::OnInit()
 {
+#ifdef _WIN32
     ImGuiIO &io = ImGui::GetIO();
     io.Fonts->AddFontFromFileTTF("C:\\Windows\\Fonts\\segoeui.ttf", 22.0f);
+#endif
 
     auto &style = ImGui::GetStyle();
     style.ItemSpacing = ImVec2(10, 10);
 
     glClearColor(0.56f, 0.7f, 0.67f, 1.0f);
 
-    // RtMidiOut constructor
-    try
+    // Native backend unless another one is asked for with --backend
+    auto backend = MidiSinkBackends().front();
+    long long dinRate = 0;
+    tRealtimeOptions realtime;
+    for (size_t i = 0; i < _args.size(); i++)
+    {
+        if (_args[i] == "--backend" && i + 1 < _args.size())
+        {
+            backend = _args[++i];
+        }
+        else if (_args[i] == "--max-fps" && i + 1 < _args.size())
+        {
+            _maxFps = std::max(1, std::atoi(_args[++i].c_str()));
+        }
+        else if (_args[i] == "--idle-fps" && i + 1 < _args.size())
+        {
+            _idleFps = std::max(1, std::atoi(_args[++i].c_str()));
+        }
+        else if (_args[i] == "--trace" && i + 1 < _args.size())
+        {
+            _tracer.Open(_args[++i]);
+        }
+        else if (_args[i] == "--din")
+        {
+            dinRate = DinOutputSink::DefaultBytesPerSecond;
+        }
+        else if (_args[i] == "--din-rate" && i + 1 < _args.size())
+        {
+            dinRate = std::atoll(_args[++i].c_str());
+        }
+        else
+        {
+            ParseRealtimeOption(_args, i, realtime);
+        }
+    }
+
+    _sink = CreateMidiSink(backend);
+    if (_sink != nullptr && dinRate > 0)
     {
-        _midiout = new RtMidiOut();
+        _din = new DinOutputSink(_sink, dinRate);
+        _sink = _din;
     }
-    catch (RtMidiError &error)
+    if (_sink == nullptr || !_sink->Init())
     {
-        error.printMessage();
         exit(EXIT_FAILURE);
     }
 
-    auto ports = _midiout->getPortCount();
+    _portNames = _sink->PortNames();
 
-    for (unsigned int i = 0; i < ports; i++)
+    _engine.SetRealtime(realtime);
+    _engine.SetTracer(&_tracer);
+    _engine.Start(_sink);
+    for (auto &problem : _engine.RealtimeProblems())
     {
-        try
-        {
-            _portNames.push_back(_midiout->getPortName(i));
-        }
-        catch (RtMidiError &error)
-        {
-            error.printMessage();
-        }
+        std::cerr << "Warning: " << problem << std::endl;
+    }
+
+    // Without an input the piano keys still work
+    _input = new MidiInput(_engine);
+    if (_input->Init())
+    {
+        _inputPortNames = _input->PortNames();
     }
 
     tChannel channel;
     channel._name = "First Arp";
     _channels.push_back(channel);
+    _engine.PostWaiting({EngineCommandTypes::AddChannel});
+    _engine.PostWaiting({EngineCommandTypes::SetBpm, 0, 0, 0, _bpm});
+
+    // The UI starts out recording, the engine has to know
+    PostPlaying();
 }
 
 void App::OnResize(
@@ -72,12 +120,21 @@ void App::OnResize(
     glViewport(0, 0, width, height);
 
     std::cout << _width << "x" << _height << std::endl;
+
+    Invalidate();
 }
 
-ImVec2 buttonSize(50, 80);
+void App::Invalidate()
+{
+    _pendingFrames = 3;
+}
 
-const unsigned char MIDI_NOTE_ON = 144;
-const unsigned char MIDI_NOTE_OFF = 128;
+bool App::NeedsFrame() const
+{
+    return _pendingFrames > 0 || _engine.Changes() != _engineChanges;
+}
+
+ImVec2 buttonSize(50, 80);
 
 void App::PianoKey(
     struct tChannel &ch,
@@ -89,33 +146,21 @@ void App::PianoKey(
 
     ImGui::Button(label, buttonSize);
 
-    if (notesDown.find(note) == notesDown.end() && ImGui::IsItemClicked())
-    {
-        unsigned char state = MIDI_NOTE_ON | ch._channel;
+    auto &notesDown = _notesDown[ch._channel];
 
-        std::vector<unsigned char> message = {
-            state,
-            note,
-            velocity,
-        };
-        _midiout->sendMessage(&message);
-        notesDown.insert(note);
+    if (!notesDown.Test(note) && ImGui::IsItemClicked())
+    {
+        PostChannelCommand(ch, {EngineCommandTypes::NoteOn, 0, note, velocity});
+        notesDown.Set(note);
         if (recordMode)
         {
-            ch._notesToArp.push_back(note);
+            PostChannelCommand(ch, {EngineCommandTypes::AddNote, 0, note});
         }
     }
-    else if (notesDown.find(note) != notesDown.end() && ImGui::IsMouseReleased(ImGuiMouseButton_Left))
+    else if (notesDown.Test(note) && ImGui::IsMouseReleased(ImGuiMouseButton_Left))
     {
-        unsigned char state = MIDI_NOTE_OFF | ch._channel;
-
-        std::vector<unsigned char> message = {
-            state,
-            note,
-            0,
-        };
-        _midiout->sendMessage(&message);
-        notesDown.erase(note);
+        PostChannelCommand(ch, {EngineCommandTypes::NoteOff, 0, note});
+        notesDown.Clear(note);
     }
 }
 
@@ -125,135 +170,27 @@ void App::RemoveChannel(
     _channelToRemove = &ch;
 }
 
-enum ArpModes
+void App::PostChannelCommand(
+    const struct tChannel &ch,
+    tEngineCommand command)
 {
-    Up = 0,
-    Down = 1,
-    Inclusive = 2,
-    Exclusive = 3,
-    Random = 4,
-    Order = 5,
-};
-
-void App::RunNotes()
-{
-    int msBetweenNotes = int(60000.0f / _bpm);
-
-    static std::chrono::time_point<std::chrono::steady_clock> lastNote = std::chrono::steady_clock::now();
-    static unsigned char lastPlayerNote = 0;
-    static int currentDirection = 1;
-
-    auto now = std::chrono::steady_clock::now();
-    auto diff = std::chrono::duration_cast<std::chrono::milliseconds>(now - lastNote);
-
-    if (!pauseMode && !recordMode)
-    {
-        for (auto &ch : _channels)
-        {
-            if (ch._notesToArp.empty())
-            {
-                continue;
-            }
-
-            auto notes = std::vector<unsigned char>(ch._notesToArp);
-
-            if (ch._arpMode != ArpModes::Order)
-            {
-                std::sort(notes.begin(), notes.end());
-            }
-
-            if (ch._noteLength > 1.0f) ch._noteLength = 1.0f;
-            if (ch._noteLength <= 0.0f) ch._noteLength = 0.01f;
-
-            if (lastPlayerNote != 0 && diff.count() > (msBetweenNotes * ch._noteLength))
-            {
-                unsigned char state = MIDI_NOTE_OFF | ch._channel;
-
-                std::vector<unsigned char> message = {
-                    state,
-                    lastPlayerNote,
-                    0,
-                };
-                _midiout->sendMessage(&message);
-                lastPlayerNote = 0;
-            }
-
-            if (diff.count() > msBetweenNotes)
-            {
-                unsigned char state = MIDI_NOTE_ON | ch._channel;
-
-                lastPlayerNote = notes[ch._currentNote];
-                std::vector<unsigned char> message = {
-                    state,
-                    lastPlayerNote,
-                    static_cast<unsigned char>(ch._velocity),
-                };
-                _midiout->sendMessage(&message);
-                lastNote = now;
-
-                if (ch._arpMode == ArpModes::Up || ch._arpMode == ArpModes::Order)
-                {
-                    ch._currentNote++;
-                    if (ch._currentNote >= ch._notesToArp.size())
-                    {
-                        ch._currentNote = 0;
-                    }
-                }
-                else if (ch._arpMode == ArpModes::Down)
-                {
-                    if (ch._currentNote == 0)
-                    {
-                        ch._currentNote = ch._notesToArp.size() - 1;
-                    }
-                    else
-                    {
-                        ch._currentNote--;
-                    }
-                }
-                else if (ch._arpMode == ArpModes::Inclusive)
-                {
-                    if (currentDirection < 0 && ch._currentNote == 0)
-                    {
-                        currentDirection = 1;
-                    }
-                    else if (currentDirection > 0 && ch._currentNote + 1 >= ch._notesToArp.size())
-                    {
-                        currentDirection = -1;
-                    }
-                    else
-                    {
-                        ch._currentNote += currentDirection;
-                    }
-                }
-                else if (ch._arpMode == ArpModes::Exclusive)
-                {
-                    if (currentDirection < 0 && ch._currentNote == 0)
-                    {
-                        currentDirection = 1;
-                    }
-                    else if (currentDirection > 0 && ch._currentNote + 1 >= ch._notesToArp.size())
-                    {
-                        currentDirection = -1;
-                    }
+    command._channelIndex = size_t(&ch - _channels.data());
+    _engine.PostWaiting(command);
+}
 
-                    ch._currentNote += currentDirection;
-                }
-                else if (ch._arpMode == ArpModes::Random)
-                {
-                    ch._currentNote = std::rand() % ch._notesToArp.size();
-                }
-            }
-        }
-    }
-    else
-    {
-        lastNote = now;
-    }
+void App::PostPlaying()
+{
+    _engine.PostWaiting({EngineCommandTypes::SetPlaying, 0, 0, (!pauseMode && !recordMode) ? 1 : 0});
+    _engine.PostWaiting({EngineCommandTypes::SetRecording, 0, 0, recordMode ? 1 : 0});
 }
 
 void App::OnFrame()
 {
-    RunNotes();
+    if (_pendingFrames > 0)
+    {
+        _pendingFrames--;
+    }
+    _engineChanges = _engine.Changes();
 
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -288,23 +225,7 @@ void App::OnFrame()
             pauseMode = false;
         }
         recordMode = false;
-        if (pauseMode)
-        {
-            for (auto &ch : _channels)
-            {
-                for (auto &note : ch._notesToArp)
-                {
-                    unsigned char state = MIDI_NOTE_OFF | ch._channel;
-
-                    std::vector<unsigned char> message = {
-                        state,
-                        note,
-                        0,
-                    };
-                    _midiout->sendMessage(&message);
-                }
-            }
-        }
+        PostPlaying();
     }
 
     ImGui::SameLine();
@@ -327,39 +248,121 @@ void App::OnFrame()
     if (ImGui::IsItemClicked())
     {
         recordMode = !recordMode;
+        PostPlaying();
         if (recordMode)
         {
             for (auto &ch : _channels)
             {
-                for (auto &note : ch._notesToArp)
-                {
-                    unsigned char state = MIDI_NOTE_OFF | ch._channel;
-
-                    std::vector<unsigned char> message = {
-                        state,
-                        note,
-                        0,
-                    };
-                    _midiout->sendMessage(&message);
-                }
-                ch._notesToArp.clear();
-                ch._currentNote = 0;
+                PostChannelCommand(ch, {EngineCommandTypes::ClearNotes});
             }
         }
     }
 
     ImGui::SameLine();
 
-    ImGui::SliderFloat("BPM", &_bpm, 80.0f, 180.0f);
+    if (ImGui::SliderFloat("BPM", &_bpm, 80.0f, 180.0f))
+    {
+        _engine.PostWaiting({EngineCommandTypes::SetBpm, 0, 0, 0, _bpm});
+    }
+
+    ImGui::SameLine();
+
+    static int sync = 0;
+    if (ImGui::RadioButton("Internal clock", &sync, 0))
+    {
+        _engine.PostWaiting({EngineCommandTypes::SetFollowClock, 0, 0, 0});
+    }
+
+    ImGui::SameLine();
+
+    if (ImGui::RadioButton("MIDI clock", &sync, 1))
+    {
+        _engine.PostWaiting({EngineCommandTypes::SetFollowClock, 0, 0, 1});
+    }
+
+    ImGui::SameLine();
+
+    static bool sendClock = false;
+    if (ImGui::Checkbox("Send clock", &sendClock))
+    {
+        _engine.PostWaiting({EngineCommandTypes::SetSendClock, 0, 0, sendClock ? 1 : 0});
+    }
+
+    ImGui::SameLine();
+
+    auto stats = _engine.Stats();
+    if (sync == 1)
+    {
+        ImGui::Text("Clock %.2f BPM", stats._clockBpm);
+        ImGui::SameLine();
+    }
+    ImGui::Text("Tempo error %+.3f BPM, max late %.2f ms, missed %lld, input late %.2f ms", stats._tempoError, stats._maxLatenessMs, stats._missedSteps, stats._maxInputLatencyMs);
+
+    if (_din != nullptr)
+    {
+        auto din = _din->Stats();
+        ImGui::Text(
+            "DIN: %lld bytes sent, %lld queued (max %lld), %lld messages dropped",
+            din._sentBytes,
+            din._queuedBytes,
+            din._maxQueuedBytes,
+            din._droppedMessages);
+    }
+
+    for (auto &problem : _engine.RealtimeProblems())
+    {
+        ImGui::TextColored(ImVec4(1.0f, 0.5f, 0.5f, 1.0f), "%s", problem.c_str());
+    }
+
+    if (ImGui::CollapsingHeader("Timing"))
+    {
+        // Lateness is how far past its due time a message reached the sink,
+        // send is how long the sink took with it, both in microseconds
+        if (ImGui::BeginTable("timing", 10, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+        {
+            const char *columns[] = {"Midi", "Messages", "Late p50", "p99", "p99.9", "max", "Send p50", "p99", "p99.9", "max"};
+            for (auto column : columns)
+            {
+                ImGui::TableSetupColumn(column);
+            }
+            ImGui::TableHeadersRow();
+
+            for (int i = 0; i < 16; i++)
+            {
+                auto &timing = _engine.Timing(i);
+                auto lateness = timing._lateness.Summary();
+                if (lateness._count == 0)
+                {
+                    continue;
+                }
+                auto send = timing._sendDuration.Summary();
+
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::Text("%d", i + 1);
+                ImGui::TableNextColumn();
+                ImGui::Text("%lld", lateness._count);
+                for (auto &summary : {lateness, send})
+                {
+                    for (auto value : {summary._p50, summary._p99, summary._p999, summary._max})
+                    {
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%.1f", value / 1000.0);
+                    }
+                }
+            }
+            ImGui::EndTable();
+        }
+    }
 
     ImGui::Separator();
 
     ImGui::BeginGroup();
     ImGui::Text("Midi output");
     static int e = 0;
-    if (ImGui::RadioButton("No Midi output", &e, 0) && _midiout->isPortOpen())
+    if (ImGui::RadioButton("No Midi output", &e, 0))
     {
-        _midiout->closePort();
+        _engine.PostWaiting({EngineCommandTypes::ClosePort});
     }
 
     for (size_t i = 0; i < _portNames.size(); i++)
@@ -367,11 +370,25 @@ void App::OnFrame()
         ImGui::SameLine();
         if (ImGui::RadioButton(_portNames[i].c_str(), &e, int(i + 1)))
         {
-            if (_midiout->isPortOpen())
-            {
-                _midiout->closePort();
-            }
-            _midiout->openPort(int(i));
+            _engine.PostWaiting({EngineCommandTypes::OpenPort, 0, 0, int(i)});
+        }
+    }
+    ImGui::EndGroup();
+
+    ImGui::BeginGroup();
+    ImGui::Text("Midi input");
+    static int in = 0;
+    if (ImGui::RadioButton("No Midi input", &in, 0))
+    {
+        _input->ClosePort();
+    }
+
+    for (size_t i = 0; i < _inputPortNames.size(); i++)
+    {
+        ImGui::SameLine();
+        if (ImGui::RadioButton((_inputPortNames[i] + "##in").c_str(), &in, int(i + 1)))
+        {
+            _input->OpenPort(static_cast<unsigned int>(i));
         }
     }
     ImGui::EndGroup();
@@ -410,9 +427,15 @@ void App::OnFrame()
                     }
                 }
 
+                if (_channels.size() >= Engine::MaxChannels)
+                {
+                    error = "Too many channels";
+                }
+
                 if (error == nullptr)
                 {
                     _channels.push_back(channel);
+                    _engine.PostWaiting({EngineCommandTypes::AddChannel});
                     memset(buf, 0, 64);
                 }
             }
@@ -436,6 +459,7 @@ void App::OnFrame()
         {
             if (channel->_name == _channelToRemove->_name)
             {
+                PostChannelCommand(*channel, {EngineCommandTypes::RemoveChannel});
                 _channels.erase(channel);
                 _channelToRemove = nullptr;
                 break;
@@ -480,6 +504,50 @@ void App::RenderChannel(
             if (ImGui::Selectable(channels[i], is_selected))
             {
                 ch._channel = i;
+                PostChannelCommand(ch, {EngineCommandTypes::SetMidiChannel, 0, 0, i});
+            }
+
+            if (is_selected)
+            {
+                ImGui::SetItemDefaultFocus();
+            }
+        }
+        ImGui::EndCombo();
+    }
+
+    ImGui::SameLine();
+
+    const char *inputs[] = {
+        "Input off",
+        "Input channel 1",
+        "Input channel 2",
+        "Input channel 3",
+        "Input channel 4",
+        "Input channel 5",
+        "Input channel 6",
+        "Input channel 7",
+        "Input channel 8",
+        "Input channel 9",
+        "Input channel 10",
+        "Input channel 11",
+        "Input channel 12",
+        "Input channel 13",
+        "Input channel 14",
+        "Input channel 15",
+        "Input channel 16",
+        "Input omni",
+    };
+
+    ImGui::SetNextItemWidth(200);
+    if (ImGui::BeginCombo("##Input", inputs[ch._inputChannel + 1], flags))
+    {
+        for (int i = InputOff; i <= InputOmni; i++)
+        {
+            const bool is_selected = (ch._inputChannel == i);
+            if (ImGui::Selectable(inputs[i + 1], is_selected))
+            {
+                ch._inputChannel = i;
+                PostChannelCommand(ch, {EngineCommandTypes::SetInputChannel, 0, 0, i});
             }
 
             if (is_selected)
@@ -495,7 +563,7 @@ void App::RenderChannel(
     static char buf[64] = {0};
     if (ImGui::Button("Change name"))
     {
-        strcpy_s(buf, 64, ch._name.c_str());
+        snprintf(buf, sizeof(buf), "%s", ch._name.c_str());
         ImGui::OpenPopup("Change the name");
     }
 
@@ -556,32 +624,41 @@ void App::RenderChannel(
 
     ImGui::BeginGroup();
     ImGui::Text("Arp Mode");
-    ImGui::RadioButton("Up", &(ch._arpMode), ArpModes::Up);
+    bool arpModeChanged = false;
+    arpModeChanged |= ImGui::RadioButton("Up", &(ch._arpMode), ArpModes::Up);
 
     ImGui::SameLine();
 
-    ImGui::RadioButton("Down", &(ch._arpMode), ArpModes::Down);
+    arpModeChanged |= ImGui::RadioButton("Down", &(ch._arpMode), ArpModes::Down);
 
     ImGui::SameLine();
 
-    ImGui::RadioButton("Inclusive up/down", &(ch._arpMode), ArpModes::Inclusive);
+    arpModeChanged |= ImGui::RadioButton("Inclusive up/down", &(ch._arpMode), ArpModes::Inclusive);
 
     ImGui::SameLine();
 
-    ImGui::RadioButton("Exclusive up/down", &(ch._arpMode), ArpModes::Exclusive);
+    arpModeChanged |= ImGui::RadioButton("Exclusive up/down", &(ch._arpMode), ArpModes::Exclusive);
 
     ImGui::SameLine();
 
-    ImGui::RadioButton("Random", &(ch._arpMode), ArpModes::Random);
+    arpModeChanged |= ImGui::RadioButton("Random", &(ch._arpMode), ArpModes::Random);
 
     ImGui::SameLine();
 
-    ImGui::RadioButton("Order", &(ch._arpMode), ArpModes::Order);
+    arpModeChanged |= ImGui::RadioButton("Order", &(ch._arpMode), ArpModes::Order);
     ImGui::EndGroup();
 
+    if (arpModeChanged)
+    {
+        PostChannelCommand(ch, {EngineCommandTypes::SetArpMode, 0, 0, ch._arpMode});
+    }
+
     ImGui::Separator();
 
-    ImGui::KnobUchar("Velocity", &(ch._velocity), 0, 127, ImVec2(80.0f, 60.0f));
+    if (ImGui::KnobUchar("Velocity", &(ch._velocity), 0, 127, ImVec2(80.0f, 60.0f)))
+    {
+        PostChannelCommand(ch, {EngineCommandTypes::SetVelocity, 0, 0, ch._velocity});
+    }
 
     ImGui::SameLine();
 
@@ -589,7 +666,10 @@ void App::RenderChannel(
 
     ImGui::SameLine();
 
-    ImGui::Knob("Note length", &(ch._noteLength), 0.01f, 0.99f, ImVec2(80.0f, 60.0f));
+    if (ImGui::Knob("Note length", &(ch._noteLength), 0.01f, 0.99f, ImVec2(80.0f, 60.0f)))
+    {
+        PostChannelCommand(ch, {EngineCommandTypes::SetNoteLength, 0, 0, 0, ch._noteLength});
+    }
 
     ImGui::SameLine();
 
@@ -597,40 +677,28 @@ void App::RenderChannel(
     ImGui::Text("Operations on recorded notes");
     if (ImGui::Button("octave down"))
     {
-        for (auto &note : ch._notesToArp)
-        {
-            note -= 12;
-        }
+        PostChannelCommand(ch, {EngineCommandTypes::TransposeNotes, 0, 0, -12});
     }
 
     ImGui::SameLine();
 
     if (ImGui::Button("octave up"))
     {
-        for (auto &note : ch._notesToArp)
-        {
-            note += 12;
-        }
+        PostChannelCommand(ch, {EngineCommandTypes::TransposeNotes, 0, 0, 12});
     }
 
     ImGui::SameLine();
 
     if (ImGui::Button("note down"))
     {
-        for (auto &note : ch._notesToArp)
-        {
-            note -= 1;
-        }
+        PostChannelCommand(ch, {EngineCommandTypes::TransposeNotes, 0, 0, -1});
     }
 
     ImGui::SameLine();
 
     if (ImGui::Button("note up"))
     {
-        for (auto &note : ch._notesToArp)
-        {
-            note += 1;
-        }
+        PostChannelCommand(ch, {EngineCommandTypes::TransposeNotes, 0, 0, 1});
     }
 
     ImGui::EndGroup();
@@ -701,22 +769,14 @@ void App::RenderChannel(
 
 void App::OnExit()
 {
-    for (auto &ch : _channels)
-    {
-        for (auto &note : ch._notesToArp)
-        {
-            unsigned char state = MIDI_NOTE_OFF | ch._channel;
-
-            std::vector<unsigned char> message = {
-                state,
-                note,
-                0,
-            };
-            _midiout->sendMessage(&message);
-        }
-    }
+    delete _input;
+    _input = nullptr;
+
+    _engine.Stop();
+
+    delete _sink;
+    _sink = nullptr;
+    _din = nullptr;
 
-    _midiout->closePort();
-    delete _midiout;
-    _midiout = nullptr;
+    _tracer.Close();
 }
@@ -0,0 +1,378 @@
+#include <config.h>
+#include <dinoutput.hpp>
+#include <engine.hpp>
+#include <midiinput.hpp>
+#include <midisink.hpp>
+#include <offlinerender.hpp>
+#include <session.hpp>
+#include <tracer.hpp>
+
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static volatile std::sig_atomic_t stopRequested = 0;
+
+static void RequestStop(
+    int)
+{
+    stopRequested = 1;
+}
+
+static void WriteSummary(
+    std::ostream &out,
+    const char *name,
+    const tHistogramSummary &summary)
+{
+    out << " " << name << " p50 " << summary._p50 / 1000.0
+        << " p99 " << summary._p99 / 1000.0
+        << " p99.9 " << summary._p999 / 1000.0
+        << " max " << summary._max / 1000.0 << " us";
+}
+
+// One line per MIDI channel that sent anything, times in microseconds
+static void WriteTimingReport(
+    std::ostream &out,
+    const Engine &engine,
+    const DinOutputSink *din)
+{
+    auto stats = engine.Stats();
+    out << std::fixed << std::setprecision(1)
+        << "timing: tempo error " << stats._tempoError << " BPM, missed " << stats._missedSteps << std::endl;
+
+    if (din != nullptr)
+    {
+        auto dinStats = din->Stats();
+        out << "din: " << dinStats._sentBytes << " bytes sent, "
+            << dinStats._queuedBytes << " queued (max " << dinStats._maxQueuedBytes << "), "
+            << dinStats._droppedMessages << " messages (" << dinStats._droppedBytes << " bytes) dropped" << std::endl;
+    }
+
+    for (int i = 0; i < 16; i++)
+    {
+        auto &timing = engine.Timing(i);
+        auto lateness = timing._lateness.Summary();
+        if (lateness._count == 0)
+        {
+            continue;
+        }
+
+        out << "timing: midi " << (i + 1) << ", " << lateness._count << " messages,";
+        WriteSummary(out, "late", lateness);
+        out << ",";
+        WriteSummary(out, "send", timing._sendDuration.Summary());
+        out << std::endl;
+    }
+}
+
+static void PrintUsage()
+{
+    std::cout << "usage: arpd [options] <session file>\n"
+              << "    --backend <name> midi output backend:";
+    for (auto &backend : MidiSinkBackends())
+    {
+        std::cout << " " << backend;
+    }
+    std::cout << "\n"
+              << "    --list-ports    list the midi output ports and exit\n"
+              << "    --port <n>      midi output port, overrides the session\n"
+              << "    --clock-in <n>  follow MIDI clock, Start and Stop from this midi input port\n"
+              << "    --send-clock    send MIDI clock, Start and Stop on the output port\n"
+              << "    --bpm <bpm>     tempo, overrides the session\n"
+              << "    --render <file> render to a Standard MIDI File instead of playing\n"
+              << "    --events        render and print the event list instead of playing\n"
+              << "    --bars <n>      number of bars to render, 4 by default\n"
+              << "    --stats <s>     print timing histograms every s seconds\n"
+              << "    --stats-file <file> append them to this file instead\n"
+              << "    --trace <file>  write a Chrome trace of the engine thread\n"
+              << "    --din           limit output to what a DIN port carries, 3125 bytes/s\n"
+              << "    --din-rate <n>  the same with a budget of n bytes/s\n"
+              << RealtimeUsage();
+}
+
+int main(int argc, char *argv[])
+{
+    const std::vector<std::string> args(argv + 1, argv + argc);
+
+    std::cout << APP_NAME << "d version " << APP_VERSION << std::endl;
+
+    std::string backend = MidiSinkBackends().front();
+    bool listPorts = false;
+    int clockIn = -1;
+    bool sendClock = false;
+    tRealtimeOptions realtime;
+    int statsInterval = 0;
+    std::string statsPath;
+    std::string tracePath;
+    long long dinRate = 0;
+    int port = -1;
+    float bpm = 0.0f;
+    std::string renderPath;
+    bool printEvents = false;
+    int bars = 4;
+    std::string sessionPath;
+
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        if (args[i] == "--backend" && i + 1 < args.size())
+        {
+            backend = args[++i];
+        }
+        else if (args[i] == "--list-ports")
+        {
+            listPorts = true;
+        }
+        else if (args[i] == "--clock-in" && i + 1 < args.size())
+        {
+            clockIn = std::atoi(args[++i].c_str());
+        }
+        else if (args[i] == "--send-clock")
+        {
+            sendClock = true;
+        }
+        else if (args[i] == "--port" && i + 1 < args.size())
+        {
+            port = std::atoi(args[++i].c_str());
+        }
+        else if (args[i] == "--bpm" && i + 1 < args.size())
+        {
+            bpm = float(std::atof(args[++i].c_str()));
+        }
+        else if (args[i] == "--render" && i + 1 < args.size())
+        {
+            renderPath = args[++i];
+        }
+        else if (args[i] == "--events")
+        {
+            printEvents = true;
+        }
+        else if (args[i] == "--bars" && i + 1 < args.size())
+        {
+            bars = std::atoi(args[++i].c_str());
+        }
+        else if (args[i] == "--stats" && i + 1 < args.size())
+        {
+            statsInterval = std::atoi(args[++i].c_str());
+        }
+        else if (args[i] == "--stats-file" && i + 1 < args.size())
+        {
+            statsPath = args[++i];
+        }
+        else if (args[i] == "--trace" && i + 1 < args.size())
+        {
+            tracePath = args[++i];
+        }
+        else if (args[i] == "--din")
+        {
+            dinRate = DinOutputSink::DefaultBytesPerSecond;
+        }
+        else if (args[i] == "--din-rate" && i + 1 < args.size())
+        {
+            dinRate = std::atoll(args[++i].c_str());
+        }
+        else if (ParseRealtimeOption(args, i, realtime))
+        {
+        }
+        else if (sessionPath.empty() && args[i][0] != '-')
+        {
+            sessionPath = args[i];
+        }
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if (!renderPath.empty() || printEvents)
+    {
+        tSession session;
+        std::string error;
+        if (sessionPath.empty() || bars <= 0)
+        {
+            PrintUsage();
+            return 1;
+        }
+        if (!LoadSession(sessionPath, session, error))
+        {
+            std::cout << error << std::endl;
+            return 1;
+        }
+        if (bpm > 0.0f) session._bpm = bpm;
+
+        OfflineRenderer renderer;
+        renderer.Render(session, bars);
+
+        if (printEvents)
+        {
+            renderer.WriteEventList(std::cout);
+        }
+
+        if (!renderPath.empty())
+        {
+            if (!renderer.WriteSmf(renderPath, error))
+            {
+                std::cout << error << std::endl;
+                return 1;
+            }
+
+            std::cout << "Rendered " << bars << " bar(s) to " << renderPath << std::endl;
+        }
+
+        return 0;
+    }
+
+    MidiSink *sink = CreateMidiSink(backend);
+    if (sink == nullptr)
+    {
+        std::cout << "Unknown backend " << backend << std::endl;
+        return 1;
+    }
+
+    DinOutputSink *din = nullptr;
+    if (dinRate > 0)
+    {
+        din = new DinOutputSink(sink, dinRate);
+        sink = din;
+    }
+    if (!sink->Init())
+    {
+        delete sink;
+        return 1;
+    }
+
+    auto portNames = sink->PortNames();
+
+    Tracer tracer;
+    Engine engine;
+    MidiInput input(engine);
+    std::vector<std::string> inputPortNames;
+    if (listPorts || clockIn >= 0)
+    {
+        if (input.Init())
+        {
+            inputPortNames = input.PortNames();
+        }
+    }
+
+    if (listPorts)
+    {
+        for (size_t i = 0; i < portNames.size(); i++)
+        {
+            std::cout << i << ": " << portNames[i] << std::endl;
+        }
+        for (size_t i = 0; i < inputPortNames.size(); i++)
+        {
+            std::cout << "input " << i << ": " << inputPortNames[i] << std::endl;
+        }
+        delete sink;
+        return 0;
+    }
+
+    if (clockIn >= int(inputPortNames.size()))
+    {
+        std::cout << "No valid midi input port, use --list-ports to see them" << std::endl;
+        delete sink;
+        return 1;
+    }
+
+    if (sessionPath.empty())
+    {
+        PrintUsage();
+        delete sink;
+        return 1;
+    }
+
+    tSession session;
+    std::string error;
+    if (!LoadSession(sessionPath, session, error))
+    {
+        std::cout << error << std::endl;
+        delete sink;
+        return 1;
+    }
+
+    if (port >= 0) session._port = port;
+    if (bpm > 0.0f) session._bpm = bpm;
+
+    if (session._port < 0 || session._port >= int(portNames.size()))
+    {
+        std::cout << "No valid midi output port, use --list-ports to see them" << std::endl;
+        delete sink;
+        return 1;
+    }
+
+    std::signal(SIGINT, RequestStop);
+    std::signal(SIGTERM, RequestStop);
+
+    if (!tracePath.empty() && tracer.Open(tracePath))
+    {
+        engine.SetTracer(&tracer);
+    }
+
+    engine.SetRealtime(realtime);
+    engine.Start(sink);
+    for (auto &problem : engine.RealtimeProblems())
+    {
+        std::cout << "Warning: " << problem << std::endl;
+    }
+    engine.PostWaiting({EngineCommandTypes::OpenPort, 0, 0, session._port});
+    PostSession(engine, session);
+    engine.PostWaiting({EngineCommandTypes::SetSendClock, 0, 0, sendClock ? 1 : 0});
+
+    if (clockIn >= 0)
+    {
+        // Playing starts with the clock master's Start or Continue
+        engine.PostWaiting({EngineCommandTypes::SetFollowClock, 0, 0, 1});
+        input.OpenPort(static_cast<unsigned int>(clockIn));
+
+        std::cout << "Following the clock on " << inputPortNames[clockIn] << ", playing " << session._channels.size() << " channel(s) on "
+                  << portNames[session._port] << " (" << backend << "), Ctrl+C to stop" << std::endl;
+    }
+    else
+    {
+        engine.PostWaiting({EngineCommandTypes::SetPlaying, 0, 0, 1});
+
+        std::cout << "Playing " << session._channels.size() << " channel(s) at " << session._bpm << " BPM on "
+                  << portNames[session._port] << " (" << backend << "), Ctrl+C to stop" << std::endl;
+    }
+
+    std::ofstream statsFile;
+    if (!statsPath.empty())
+    {
+        statsFile.open(statsPath, std::ios::app);
+        if (statsInterval <= 0) statsInterval = 10;
+    }
+    std::ostream &statsOut = statsFile.is_open() ? statsFile : std::cout;
+
+    auto nextStats = std::chrono::steady_clock::now() + std::chrono::seconds(statsInterval);
+    while (!stopRequested)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        if (statsInterval > 0 && std::chrono::steady_clock::now() >= nextStats)
+        {
+            WriteTimingReport(statsOut, engine, din);
+            nextStats += std::chrono::seconds(statsInterval);
+        }
+    }
+
+    if (statsInterval > 0)
+    {
+        WriteTimingReport(statsOut, engine, din);
+    }
+
+    input.ClosePort();
+    engine.Stop();
+    tracer.Close();
+
+    delete sink;
+
+    return 0;
+}
@@ -0,0 +1,183 @@
+#include <clock.hpp>
+#include <engine.hpp>
+#include <nullsink.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static const char *arpModeNames[] = {
+    "up",
+    "down",
+    "inclusive",
+    "exclusive",
+    "random",
+    "order",
+};
+
+// Engine on a virtual clock, driven one tick at a time. Every tick is
+// flushed like on the engine thread, so the batching and sorting count, but
+// messages end in a null sink unless another sink is given.
+class BenchEngine : public Engine
+{
+public:
+    BenchEngine(
+        size_t channels,
+        MidiSink *sink = nullptr)
+        : Engine(channels)
+    {
+        SetClock(&_virtualClock);
+        _sink = sink != nullptr ? sink : &_nullSink;
+    }
+
+    void Setup(
+        size_t channels,
+        size_t notes,
+        int arpMode)
+    {
+        // Fast enough that the engine never wakes up without work
+        Apply({EngineCommandTypes::SetBpm, 0, 0, 0, 1200.0f});
+        Apply({EngineCommandTypes::SetSeed, 0, 0, 1});
+        for (size_t i = 0; i < channels; i++)
+        {
+            Apply({EngineCommandTypes::AddChannel});
+            Apply({EngineCommandTypes::SetMidiChannel, i, 0, int(i % 16)});
+            Apply({EngineCommandTypes::SetArpMode, i, 0, arpMode});
+            for (size_t n = 0; n < notes; n++)
+            {
+                Apply({EngineCommandTypes::AddNote, i, static_cast<unsigned char>(n)});
+            }
+        }
+        Apply({EngineCommandTypes::SetPlaying, 0, 0, 1});
+    }
+
+    void Tick()
+    {
+        auto nextDue = RunNotes();
+        Flush();
+        _virtualClock.Set(nextDue);
+    }
+
+    void SendMessage()
+    {
+        Send(Now(), 0x90, 60, 100);
+        Flush();
+    }
+
+    long long Messages() const
+    {
+        return _nullSink.Messages();
+    }
+
+private:
+    VirtualClock _virtualClock;
+    NullSink _nullSink;
+};
+
+static double Elapsed(
+    std::chrono::steady_clock::time_point start)
+{
+    return double(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+int main(int argc, char *argv[])
+{
+    const std::vector<std::string> args(argv + 1, argv + argc);
+
+    std::string outPath;
+    long long budget = 200000;
+
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        if (args[i] == "--out" && i + 1 < args.size())
+        {
+            outPath = args[++i];
+        }
+        else if (args[i] == "--steps" && i + 1 < args.size())
+        {
+            budget = std::atoll(args[++i].c_str());
+        }
+        else
+        {
+            std::cout << "usage: arp_bench [--out <file.json>] [--steps <channel steps per case>]\n";
+            return 1;
+        }
+    }
+
+    const size_t channelCounts[] = {1, 16, 256, 4096};
+    const size_t noteCounts[] = {1, 8, 32, 128};
+
+    std::stringstream json;
+    json << "{\n  \"benchmarks\": [\n";
+
+    bool first = true;
+    for (auto channels : channelCounts)
+    {
+        for (auto notes : noteCounts)
+        {
+            for (int arpMode = 0; arpMode < 6; arpMode++)
+            {
+                BenchEngine engine(channels);
+                engine.Setup(channels, notes, arpMode);
+
+                // Every step is one tick firing all channels and one tick
+                // releasing them, each channel sends a note on and off
+                long long ticks = 2 * std::max(16LL, budget / (long long)channels);
+
+                auto start = std::chrono::steady_clock::now();
+                for (long long t = 0; t < ticks; t++)
+                {
+                    engine.Tick();
+                }
+                auto elapsed = Elapsed(start);
+
+                json << (first ? "" : ",\n")
+                     << "    {\"name\": \"tick\", \"channels\": " << channels
+                     << ", \"notes\": " << notes
+                     << ", \"mode\": \"" << arpModeNames[arpMode] << "\""
+                     << ", \"ticks\": " << ticks
+                     << ", \"messages\": " << engine.Messages()
+                     << ", \"ns_per_tick\": " << elapsed / double(ticks)
+                     << ", \"ns_per_channel_step\": " << elapsed / double(engine.Messages() / 2)
+                     << "}";
+                first = false;
+            }
+        }
+    }
+
+    // Through the null sink, so this is the engine's own cost of a send
+    // without any driver
+    {
+        NullSink nullSink;
+        BenchEngine engine(1, &nullSink);
+
+        const long long messages = 1000000;
+        auto start = std::chrono::steady_clock::now();
+        for (long long m = 0; m < messages; m++)
+        {
+            engine.SendMessage();
+        }
+        auto elapsed = Elapsed(start);
+
+        json << ",\n    {\"name\": \"send\", \"api\": \"null\", \"messages\": " << messages
+             << ", \"ns_per_message\": " << elapsed / double(messages) << "}";
+    }
+
+    json << "\n  ]\n}\n";
+
+    if (outPath.empty())
+    {
+        std::cout << json.str();
+        return 0;
+    }
+
+    std::ofstream file(outPath);
+    file << json.str();
+
+    return file.good() ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+#include <capturesink.hpp>
+
+#include <cstring>
+#include <iostream>
+
+static const char CaptureMagic[8] = {'A', 'R', 'P', 'C', 'A', 'P', '0', '1'};
+
+const char *const CaptureSink::DefaultPath = "arp.capture";
+
+CaptureSink::CaptureSink(
+    const std::string &path)
+    : _path(path)
+{}
+
+CaptureSink::~CaptureSink() = default;
+
+bool CaptureSink::Init()
+{
+    _file.open(_path, std::ios::binary | std::ios::trunc);
+    if (!_file.is_open())
+    {
+        std::cerr << "Cannot open capture file " << _path << std::endl;
+        return false;
+    }
+
+    _file.write(CaptureMagic, sizeof(CaptureMagic));
+
+    return _file.good();
+}
+
+std::vector<std::string> CaptureSink::PortNames()
+{
+    return {_path};
+}
+
+void CaptureSink::OpenPort(
+    unsigned int port)
+{
+    _open = port == 0 && _file.is_open();
+}
+
+void CaptureSink::ClosePort()
+{
+    _open = false;
+    _file.flush();
+}
+
+void CaptureSink::Send(
+    long long time,
+    const unsigned char *message,
+    size_t size)
+{
+    if (!_open || size == 0 || size > 3)
+    {
+        return;
+    }
+
+    unsigned char record[12];
+    for (int i = 0; i < 8; i++)
+    {
+        record[i] = (unsigned char)((unsigned long long)time >> (8 * i));
+    }
+    record[8] = (unsigned char)size;
+    std::memcpy(record + 9, message, size);
+
+    _file.write(reinterpret_cast<const char *>(record), std::streamsize(9 + size));
+}
+
+bool ReadCapture(
+    const std::string &path,
+    std::vector<struct tMidiMessage> &messages,
+    std::string &error)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        error = "Unable to open " + path;
+        return false;
+    }
+
+    char magic[sizeof(CaptureMagic)];
+    if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, CaptureMagic, sizeof(magic)) != 0)
+    {
+        error = path + " is not a capture file";
+        return false;
+    }
+
+    unsigned char header[9];
+    while (file.read(reinterpret_cast<char *>(header), sizeof(header)))
+    {
+        tMidiMessage message;
+        unsigned long long time = 0;
+        for (int i = 0; i < 8; i++)
+        {
+            time |= (unsigned long long)header[i] << (8 * i);
+        }
+        message._time = (long long)time;
+        message._size = header[8];
+
+        if (message._size == 0 || message._size > 3 || !file.read(reinterpret_cast<char *>(message._data), message._size))
+        {
+            error = path + " is truncated or damaged";
+            return false;
+        }
+
+        messages.push_back(message);
+    }
+
+    return true;
+}
@@ -0,0 +1,27 @@
+#include <clock.hpp>
+
+#include <chrono>
+
+Clock::~Clock() = default;
+
+long long SteadyClock::Now() const
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+long long VirtualClock::Now() const
+{
+    return _now;
+}
+
+void VirtualClock::Set(
+    long long now)
+{
+    _now = now;
+}
+
+void VirtualClock::Advance(
+    long long duration)
+{
+    _now += duration;
+}
@@ -0,0 +1,228 @@
+#include <dinoutput.hpp>
+
+#include <algorithm>
+#include <iostream>
+
+const int DinPriorities = 4;
+
+// Clock and other realtime messages first, then note-offs, then note-ons
+// and system common, everything else last and only when there is room
+static int DinPriority(
+    const struct tMidiMessage &message)
+{
+    auto status = message._data[0];
+    if (status >= 0xF8)
+    {
+        return 0;
+    }
+
+    auto type = status & 0xF0;
+    if (type == 0x80 || (type == 0x90 && message._data[2] == 0))
+    {
+        return 1;
+    }
+
+    return type == 0x90 || status >= 0xF0 ? 2 : 3;
+}
+
+static void RecordMax(
+    std::atomic<long long> &max,
+    long long value)
+{
+    // Only the engine thread writes
+    if (value > max.load(std::memory_order_relaxed))
+    {
+        max.store(value, std::memory_order_relaxed);
+    }
+}
+
+DinOutputSink::DinOutputSink(
+    MidiSink *output,
+    long long bytesPerSecond,
+    long long maxDelay)
+    : _output(output),
+      _byteTime(1000000000LL / std::max(1LL, bytesPerSecond)),
+      _maxDelay(maxDelay)
+{}
+
+DinOutputSink::~DinOutputSink()
+{
+    delete _output;
+    _output = nullptr;
+}
+
+bool DinOutputSink::Init()
+{
+    if (!_output->Init())
+    {
+        return false;
+    }
+
+    if (_output->Lookahead() == 0)
+    {
+        std::cerr << "Warning: the backend sends right away, the DIN output can only drop what does not fit" << std::endl;
+    }
+
+    return true;
+}
+
+std::vector<std::string> DinOutputSink::PortNames()
+{
+    return _output->PortNames();
+}
+
+void DinOutputSink::OpenPort(
+    unsigned int port)
+{
+    _output->OpenPort(port);
+}
+
+void DinOutputSink::ClosePort()
+{
+    _output->ClosePort();
+}
+
+long long DinOutputSink::Lookahead() const
+{
+    return _output->Lookahead();
+}
+
+void DinOutputSink::Send(
+    long long time,
+    const unsigned char *message,
+    size_t size)
+{
+    if (size == 0 || size > 3)
+    {
+        return;
+    }
+
+    tMidiMessage single;
+    single._time = time;
+    std::copy(message, message + size, single._data);
+    single._size = static_cast<unsigned char>(size);
+
+    Schedule(single);
+    Flush();
+}
+
+void DinOutputSink::SendBatch(
+    const struct tMidiMessage *messages,
+    size_t count)
+{
+    // Messages due at the same time take their slots by priority
+    size_t first = 0;
+    while (first < count)
+    {
+        auto last = first + 1;
+        while (last < count && messages[last]._time == messages[first]._time)
+        {
+            last++;
+        }
+
+        for (int priority = 0; priority < DinPriorities; priority++)
+        {
+            for (auto i = first; i < last; i++)
+            {
+                if (DinPriority(messages[i]) == priority)
+                {
+                    Schedule(messages[i]);
+                }
+            }
+        }
+
+        first = last;
+    }
+
+    Flush();
+}
+
+void DinOutputSink::DropPending()
+{
+    _output->DropPending();
+
+    // What was still waiting for the wire is gone
+    _wireFree = 0;
+}
+
+bool DinOutputSink::PollTransport(
+    struct tExternalTransport &transport)
+{
+    return _output->PollTransport(transport);
+}
+
+void DinOutputSink::SetTransportCallback(
+    TransportCallback callback,
+    void *arg)
+{
+    _output->SetTransportCallback(callback, arg);
+}
+
+tDinOutputStats DinOutputSink::Stats() const
+{
+    tDinOutputStats stats;
+
+    stats._sentBytes = _sentBytes.load(std::memory_order_relaxed);
+    stats._queuedBytes = _queuedBytes.load(std::memory_order_relaxed);
+    stats._maxQueuedBytes = _maxQueuedBytes.load(std::memory_order_relaxed);
+    stats._droppedMessages = _droppedMessages.load(std::memory_order_relaxed);
+    stats._droppedBytes = _droppedBytes.load(std::memory_order_relaxed);
+
+    return stats;
+}
+
+void DinOutputSink::Schedule(
+    const struct tMidiMessage &message)
+{
+    if (message._size == 0)
+    {
+        return;
+    }
+
+    auto queued = std::max(0LL, _wireFree - message._time) / _byteTime;
+    _queuedBytes.store(queued, std::memory_order_relaxed);
+    RecordMax(_maxQueuedBytes, queued);
+
+    auto status = message._data[0];
+    auto scheduled = message;
+    long long bytes = message._size;
+
+    if (status >= 0xF8)
+    {
+        // Realtime bytes may go in between the bytes of other messages, so
+        // they are never late, they only push the rest back
+        _wireFree = std::max(_wireFree, message._time) + _byteTime;
+    }
+    else
+    {
+        auto start = std::max(_wireFree, message._time);
+        if (DinPriority(message) == DinPriorities - 1 && start - message._time > _maxDelay)
+        {
+            _droppedMessages.fetch_add(1, std::memory_order_relaxed);
+            _droppedBytes.fetch_add(bytes, std::memory_order_relaxed);
+            return;
+        }
+
+        _wireFree = start + bytes * _byteTime;
+        scheduled._time = start;
+    }
+
+    _sentBytes.fetch_add(bytes, std::memory_order_relaxed);
+
+    if (_scheduledCount == _scheduled.size())
+    {
+        Flush();
+    }
+    _scheduled[_scheduledCount++] = scheduled;
+}
+
+void DinOutputSink::Flush()
+{
+    if (_scheduledCount == 0)
+    {
+        return;
+    }
+
+    _output->SendBatch(_scheduled.data(), _scheduledCount);
+    _scheduledCount = 0;
+}
@@ -0,0 +1,1062 @@
+#include <allocationguard.hpp>
+#include <engine.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+const unsigned char MIDI_NOTE_ON = 144;
+const unsigned char MIDI_NOTE_OFF = 128;
+const unsigned char MIDI_SONG_POSITION = 0xF2;
+const unsigned char MIDI_CLOCK = 0xF8;
+const unsigned char MIDI_START = 0xFA;
+const unsigned char MIDI_CONTINUE = 0xFB;
+const unsigned char MIDI_STOP = 0xFC;
+
+// MIDI clock pulses per beat
+const int PulsesPerBeat = 24;
+
+// Room in the tick's batch besides a note-off and a note-on per channel: a
+// beat of clock pulses, start and position messages, and what commands send
+const size_t BatchReserve = 2 * PulsesPerBeat + 64;
+
+// Offset of the given step from the origin at a tempo in thousandths of a
+// BPM. The product is split in a whole and a remainder part so it stays
+// exact without overflowing for long sets.
+static long long StepOffset(
+    long long step,
+    long long milliBpm)
+{
+    return step * (NanosecondsPerBeat / milliBpm) + (step * (NanosecondsPerBeat % milliBpm)) / milliBpm;
+}
+
+static void ResetChannel(
+    struct tArpChannel &ch)
+{
+    ch._channel = 0;
+    ch._arpMode = 0;
+    ch._velocity = 100;
+    ch._noteLength = 0.4f;
+    ch._inputChannel = InputOmni;
+    ch._notesToArp.clear();
+    ch._pool.ClearAll();
+    ch._currentNote = 0;
+    ch._playOrder.clear();
+    ch._step = 0;
+    ch._direction = 1;
+    ch._soundingNotes.ClearAll();
+    ch._noteOffDue = 0;
+}
+
+static void RebuildPlayOrder(
+    struct tArpChannel &ch)
+{
+    if (ch._arpMode == ArpModes::Order)
+    {
+        ch._playOrder.assign(ch._notesToArp.begin(), ch._notesToArp.end());
+        return;
+    }
+
+    ch._playOrder.clear();
+    ch._pool.ForEach([&ch](unsigned char note) {
+        ch._playOrder.push_back(note);
+    });
+}
+
+Engine::Engine(
+    size_t channelSlots)
+{
+    _channels.reserve(channelSlots);
+    _freeChannels.resize(channelSlots);
+    _batch.resize(channelSlots * 2 + BatchReserve);
+    _sorted.resize(_batch.size());
+    _batchOrder.resize(_batch.size());
+    _batchHandover.resize(_batch.size());
+    for (auto &ch : _freeChannels)
+    {
+        ch._notesToArp.reserve(MaxNotes);
+        ch._playOrder.reserve(MaxNotes);
+    }
+}
+
+Engine::~Engine()
+{
+    Stop();
+}
+
+void Engine::Start(
+    MidiSink *sink)
+{
+    if (_thread.joinable())
+    {
+        return;
+    }
+
+    _sink = sink;
+    _sink->SetTransportCallback(&Engine::TransportCallback, this);
+    _running = true;
+    _thread = std::thread(&Engine::Run, this);
+    _realtimeProblems = ApplyRealtime(_thread, _realtime);
+}
+
+void Engine::SetRealtime(
+    const struct tRealtimeOptions &options)
+{
+    _realtime = options;
+}
+
+void Engine::SetTracer(
+    Tracer *tracer)
+{
+    _tracer = tracer;
+}
+
+const std::vector<std::string> &Engine::RealtimeProblems() const
+{
+    return _realtimeProblems;
+}
+
+void Engine::Stop()
+{
+    _running = false;
+    _wakeTimer.Wake();
+
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+}
+
+bool Engine::Post(
+    const tEngineCommand &command)
+{
+    if (!_commands.Push(command))
+    {
+        return false;
+    }
+    _wakeTimer.Wake();
+
+    return true;
+}
+
+void Engine::PostWaiting(
+    const tEngineCommand &command)
+{
+    while (!Post(command))
+    {
+        std::this_thread::yield();
+    }
+}
+
+bool Engine::Receive(
+    long long time,
+    const unsigned char *message,
+    size_t size)
+{
+    if (size == 0 || size > 3)
+    {
+        return false;
+    }
+
+    tMidiInputEvent event;
+    event._time = time;
+    std::copy(message, message + size, event._data);
+    event._size = static_cast<unsigned char>(size);
+
+    if (!_input.Push(event))
+    {
+        return false;
+    }
+    _wakeTimer.Wake();
+
+    return true;
+}
+
+tTransportStats Engine::Stats() const
+{
+    tTransportStats stats;
+
+    stats._tempoError = _tempoError.load();
+    stats._maxLatenessMs = float(_maxLateness.load()) / 1000000.0f;
+    stats._missedSteps = _missedSteps.load();
+    stats._maxInputLatencyMs = float(_maxInputLatency.load()) / 1000000.0f;
+    stats._clockBpm = float(_clockMilliBpm.load()) / 1000.0f;
+
+    return stats;
+}
+
+unsigned long long Engine::Changes() const
+{
+    return _changes.load(std::memory_order_relaxed);
+}
+
+void Engine::Run()
+{
+    if (_realtime._stackPrefault > 0)
+    {
+        PrefaultStack(_realtime._stackPrefault);
+    }
+
+    tEngineCommand command;
+    tMidiInputEvent event;
+
+    while (_running)
+    {
+        long long nextDue = 0;
+        {
+            TraceScope trace(_tracer, EngineTrack, "Tick");
+
+            while (_commands.Pop(command))
+            {
+                Apply(command);
+            }
+
+            while (_input.Pop(event))
+            {
+                ApplyInput(event);
+            }
+
+            FollowTransport();
+
+            NoAllocationScope noAllocations;
+            nextDue = RunNotes();
+            Flush();
+        }
+
+        // Sleep until shortly before the next event and spin the rest of
+        // the way. Commands, input and transport changes wake us earlier.
+        auto spin = _realtime._spinWindow;
+
+        _wakeTimer.SleepUntil(nextDue - spin);
+        if (spin > 0)
+        {
+            _wakeTimer.SpinUntil(nextDue);
+        }
+    }
+
+    AllNotesOff();
+    Flush();
+}
+
+void Engine::Apply(
+    const tEngineCommand &command)
+{
+    if (command._type == EngineCommandTypes::AddChannel)
+    {
+        if (_freeChannels.empty())
+        {
+            return;
+        }
+        _channels.push_back(std::move(_freeChannels.back()));
+        _freeChannels.pop_back();
+        return;
+    }
+
+    if (command._type == EngineCommandTypes::SetBpm)
+    {
+        SetTempo(std::llround(double(command._floatValue) * 1000.0));
+        return;
+    }
+
+    if (command._type == EngineCommandTypes::SetPlaying)
+    {
+        bool playing = command._value != 0;
+        if (playing && !_playing)
+        {
+            Rebase();
+            _playing = true;
+            StartClock();
+        }
+        if (!playing && _playing)
+        {
+            StopPlaying();
+        }
+        return;
+    }
+
+    if (command._type == EngineCommandTypes::SetSendClock)
+    {
+        bool sendClock = command._value != 0;
+        if (sendClock == _sendClock)
+        {
+            return;
+        }
+        _sendClock = sendClock;
+        if (_playing && _sendClock)
+        {
+            StartClock();
+        }
+        if (_playing && !_sendClock)
+        {
+            SendRealtime(Now(), MIDI_STOP);
+        }
+        return;
+    }
+
+    if (command._type == EngineCommandTypes::SetFollowClock)
+    {
+        _followClock = command._value != 0;
+        _clockFollower.Reset();
+        _clockMilliBpm = 0;
+        return;
+    }
+
+    if (command._type == EngineCommandTypes::SetRecording)
+    {
+        _recording = command._value != 0;
+        return;
+    }
+
+    if (command._type == EngineCommandTypes::SetSeed)
+    {
+        _random.seed(static_cast<std::minstd_rand::result_type>(command._value));
+        return;
+    }
+
+    if (command._type == EngineCommandTypes::OpenPort)
+    {
+        if (_sink != nullptr)
+        {
+            // The note-offs go to the port the notes were played on
+            AllNotesOff();
+            Flush();
+            _sink->OpenPort(static_cast<unsigned int>(command._value));
+        }
+        return;
+    }
+
+    if (command._type == EngineCommandTypes::ClosePort)
+    {
+        if (_sink != nullptr)
+        {
+            // The note-offs go to the port the notes were played on
+            AllNotesOff();
+            Flush();
+            _sink->ClosePort();
+        }
+        return;
+    }
+
+    NoAllocationScope noAllocations;
+
+    if (command._channelIndex >= _channels.size())
+    {
+        return;
+    }
+
+    auto &ch = _channels[command._channelIndex];
+
+    switch (command._type)
+    {
+        case EngineCommandTypes::RemoveChannel:
+        {
+            NotesOff(ch, Now());
+            std::rotate(_channels.begin() + command._channelIndex, _channels.begin() + command._channelIndex + 1, _channels.end());
+            ResetChannel(_channels.back());
+            _freeChannels.push_back(std::move(_channels.back()));
+            _channels.pop_back();
+            break;
+        }
+        case EngineCommandTypes::SetMidiChannel:
+        {
+            NotesOff(ch, Now());
+            ch._channel = static_cast<unsigned char>(command._value);
+            break;
+        }
+        case EngineCommandTypes::SetInputChannel:
+        {
+            ch._inputChannel = command._value;
+            break;
+        }
+        case EngineCommandTypes::SetArpMode:
+        {
+            bool reorder = (ch._arpMode == ArpModes::Order) != (command._value == ArpModes::Order);
+            ch._arpMode = command._value;
+            if (reorder)
+            {
+                RebuildPlayOrder(ch);
+            }
+            break;
+        }
+        case EngineCommandTypes::SetVelocity:
+        {
+            ch._velocity = static_cast<unsigned char>(command._value);
+            break;
+        }
+        case EngineCommandTypes::SetNoteLength:
+        {
+            ch._noteLength = command._floatValue;
+            break;
+        }
+        case EngineCommandTypes::AddNote:
+        {
+            if (ch._notesToArp.size() >= MaxNotes || command._note > 127)
+            {
+                break;
+            }
+
+            ch._notesToArp.push_back(command._note);
+            if (ch._arpMode == ArpModes::Order)
+            {
+                ch._playOrder.push_back(command._note);
+            }
+            else if (!ch._pool.Test(command._note))
+            {
+                ch._playOrder.insert(std::upper_bound(ch._playOrder.begin(), ch._playOrder.end(), command._note), command._note);
+            }
+            ch._pool.Set(command._note);
+            break;
+        }
+        case EngineCommandTypes::TransposeNotes:
+        {
+            // The pool only moves as a whole, a shift that would push a
+            // note out of the MIDI range is ignored
+            auto fits = std::all_of(ch._notesToArp.begin(), ch._notesToArp.end(), [&command](unsigned char note) {
+                return int(note) + command._value >= 0 && int(note) + command._value <= 127;
+            });
+            if (!fits)
+            {
+                break;
+            }
+
+            ch._pool.ClearAll();
+            for (auto &note : ch._notesToArp)
+            {
+                note += command._value;
+                ch._pool.Set(note);
+            }
+            RebuildPlayOrder(ch);
+            break;
+        }
+        case EngineCommandTypes::ClearNotes:
+        {
+            NotesOff(ch, Now());
+            ch._notesToArp.clear();
+            ch._pool.ClearAll();
+            ch._playOrder.clear();
+            ch._currentNote = 0;
+            break;
+        }
+        case EngineCommandTypes::NoteOn:
+        {
+            Send(Now(), MIDI_NOTE_ON | ch._channel, command._note, static_cast<unsigned char>(command._value));
+            break;
+        }
+        case EngineCommandTypes::NoteOff:
+        {
+            Send(Now(), MIDI_NOTE_OFF | ch._channel, command._note, 0);
+            break;
+        }
+        default:
+        {
+            break;
+        }
+    }
+}
+
+void Engine::ApplyInput(
+    const tMidiInputEvent &event)
+{
+    // Clock, Start, Stop, Continue and Song Position Pointer
+    if (event._data[0] >= 0xF0)
+    {
+        struct tExternalTransport transport;
+        if (_followClock && _clockFollower.Receive(event._time, event._data, event._size, transport))
+        {
+            ApplyTransport(transport);
+        }
+        _clockMilliBpm = _followClock ? _clockFollower.MilliBpm() : 0;
+        return;
+    }
+
+    auto type = event._data[0] & 0xF0;
+    bool noteOn = type == MIDI_NOTE_ON && event._size == 3 && event._data[2] > 0;
+    bool noteOff = (type == MIDI_NOTE_OFF || type == MIDI_NOTE_ON) && event._size == 3 && !noteOn;
+
+    if (!noteOn && !noteOff)
+    {
+        return;
+    }
+
+    auto latency = Now() - event._time;
+    if (latency > _maxInputLatency)
+    {
+        _maxInputLatency = latency;
+    }
+
+    int inputChannel = event._data[0] & 0x0F;
+    for (size_t i = 0; i < _channels.size(); i++)
+    {
+        auto routing = _channels[i]._inputChannel;
+        if (routing == InputOff || (routing != InputOmni && routing != inputChannel))
+        {
+            continue;
+        }
+
+        if (noteOff)
+        {
+            Apply({EngineCommandTypes::NoteOff, i, event._data[1]});
+            continue;
+        }
+
+        Apply({EngineCommandTypes::NoteOn, i, event._data[1], event._data[2]});
+        if (_recording)
+        {
+            Apply({EngineCommandTypes::AddNote, i, event._data[1]});
+        }
+    }
+}
+
+void Engine::Send(
+    long long time,
+    unsigned char status,
+    unsigned char data1,
+    unsigned char data2)
+{
+    if (_sink == nullptr)
+    {
+        return;
+    }
+
+    const unsigned char message[] = {
+        status,
+        data1,
+        data2,
+    };
+
+    Collect(time, message, sizeof(message));
+}
+
+void Engine::Collect(
+    long long time,
+    const unsigned char *message,
+    size_t size)
+{
+    if (_sink == nullptr)
+    {
+        return;
+    }
+
+    if (_batchSize == _batch.size())
+    {
+        Flush();
+    }
+
+    // The first steps after the grid started could not go out any earlier
+    _batchHandover[_batchSize] = _sendAhead > 0 ? std::max(time - _sendAhead, _origin) : time;
+
+    auto &collected = _batch[_batchSize++];
+    collected._time = time;
+    std::copy(message, message + size, collected._data);
+    collected._size = static_cast<unsigned char>(size);
+}
+
+// Note-offs go first so a voice is free before the next note takes it,
+// then clock and other system messages, then the rest
+static int SendRank(
+    const struct tMidiMessage &message)
+{
+    auto type = message._data[0] & 0xF0;
+    if (type == MIDI_NOTE_OFF || (type == MIDI_NOTE_ON && message._data[2] == 0))
+    {
+        return 0;
+    }
+
+    return type == 0xF0 ? 1 : 2;
+}
+
+static bool SendsBefore(
+    const struct tMidiMessage &a,
+    const struct tMidiMessage &b)
+{
+    if (a._time != b._time)
+    {
+        return a._time < b._time;
+    }
+
+    return SendRank(a) < SendRank(b);
+}
+
+void Engine::Flush()
+{
+    if (_batchSize == 0 || _sink == nullptr)
+    {
+        _batchSize = 0;
+        return;
+    }
+
+    // Sorting the indices keeps messages that tie in the order they were
+    // played, std::sort does not allocate where std::stable_sort may
+    for (size_t i = 0; i < _batchSize; i++)
+    {
+        _batchOrder[i] = static_cast<unsigned int>(i);
+    }
+    std::sort(_batchOrder.begin(), _batchOrder.begin() + _batchSize, [this](unsigned int a, unsigned int b) {
+        if (SendsBefore(_batch[a], _batch[b]))
+        {
+            return true;
+        }
+        if (SendsBefore(_batch[b], _batch[a]))
+        {
+            return false;
+        }
+        return a < b;
+    });
+    for (size_t i = 0; i < _batchSize; i++)
+    {
+        _sorted[i] = _batch[_batchOrder[i]];
+    }
+
+    auto start = Now();
+    _sink->SendBatch(_sorted.data(), _batchSize);
+    auto end = Now();
+
+    unsigned int channels = 0;
+    for (size_t i = 0; i < _batchSize; i++)
+    {
+        auto status = _sorted[i]._data[0];
+        if (status >= 0xF0)
+        {
+            continue;
+        }
+
+        // A sink with lookahead gets what is played ahead that much early on
+        // purpose, being late is measured from there or it would always be 0
+        _timing[status & 0x0F]._lateness.Record(start - _batchHandover[_batchOrder[i]]);
+        channels |= 1u << (status & 0x0F);
+    }
+
+    for (int channel = 0; channel < 16; channel++)
+    {
+        if ((channels & (1u << channel)) != 0)
+        {
+            _timing[channel]._sendDuration.Record(end - start);
+        }
+    }
+
+    // The engine thread always runs on the steady clock, like the tracer
+    if (_tracer != nullptr)
+    {
+        _tracer->Record(EngineTrack, "Send", start, end);
+    }
+
+    _batchSize = 0;
+}
+
+const struct tChannelTiming &Engine::Timing(
+    int midiChannel) const
+{
+    return _timing[midiChannel & 0x0F];
+}
+
+void Engine::SendRealtime(
+    long long time,
+    unsigned char status)
+{
+    Collect(time, &status, 1);
+}
+
+void Engine::NotesOff(
+    struct tArpChannel &ch,
+    long long time)
+{
+    ch._soundingNotes.ForEach([this, &ch, time](unsigned char note) {
+        Send(time, MIDI_NOTE_OFF | ch._channel, note, 0);
+    });
+    ch._soundingNotes.ClearAll();
+}
+
+void Engine::AllNotesOff()
+{
+    // What was collected before goes out first, as if it had been sent
+    // right away, and is dropped with the rest when it is not due yet
+    Flush();
+    if (_sink != nullptr)
+    {
+        _sink->DropPending();
+    }
+
+    auto now = Now();
+    for (auto &ch : _channels)
+    {
+        NotesOff(ch, now);
+    }
+}
+
+void Engine::SetTempo(
+    long long milliBpm)
+{
+    milliBpm = std::max(1LL, milliBpm);
+    if (milliBpm == _milliBpm)
+    {
+        return;
+    }
+
+    if (_playing)
+    {
+        // Keep the last step of the grid that passed as the new origin,
+        // only the steps after it move to the new tempo.
+        auto passed = StepAt(Now());
+        _origin = StepTime(passed);
+        for (auto &ch : _channels)
+        {
+            ch._step = std::max(0LL, ch._step - passed);
+        }
+        _clockPulse = std::max(0LL, _clockPulse - passed * PulsesPerBeat);
+    }
+    _milliBpm = milliBpm;
+}
+
+void Engine::Align(
+    long long beat,
+    long long beatTime)
+{
+    auto now = Now();
+    auto oldOrigin = _origin;
+    auto halfStep = StepOffset(1, _milliBpm) / 2;
+
+    _origin = beatTime - StepOffset(beat, _milliBpm);
+
+    // Every channel moves its next step to the nearest step of the new grid,
+    // a step that would be long gone by now is skipped
+    for (auto &ch : _channels)
+    {
+        auto due = std::max(oldOrigin + StepOffset(ch._step, _milliBpm), now - halfStep);
+        ch._step = StepAt(due + halfStep);
+    }
+
+    // The clock output moves the same way, on its own finer grid
+    auto halfPulse = StepOffset(1, _milliBpm * PulsesPerBeat) / 2;
+    auto pulseDue = std::max(oldOrigin + StepOffset(_clockPulse, _milliBpm * PulsesPerBeat), now - halfPulse);
+    _clockPulse = PulseAt(pulseDue + halfPulse);
+}
+
+void Engine::TransportCallback(
+    void *arg)
+{
+    static_cast<Engine *>(arg)->_wakeTimer.Wake();
+}
+
+void Engine::FollowTransport()
+{
+    struct tExternalTransport transport;
+    if (_sink == nullptr || !_sink->PollTransport(transport))
+    {
+        return;
+    }
+
+    ApplyTransport(transport);
+}
+
+void Engine::ApplyTransport(
+    const struct tExternalTransport &transport)
+{
+    if (transport._milliBpm > 0)
+    {
+        SetTempo(transport._milliBpm);
+    }
+
+    if (!transport._rolling)
+    {
+        if (_playing)
+        {
+            StopPlaying();
+        }
+        return;
+    }
+
+    bool starting = !_playing;
+    if (starting)
+    {
+        Rebase();
+        _playing = true;
+    }
+
+    Align(transport._beat, transport._beatTime);
+
+    if (starting)
+    {
+        StartClock();
+    }
+}
+
+void Engine::StopPlaying()
+{
+    AllNotesOff();
+    if (_sendClock)
+    {
+        SendRealtime(Now(), MIDI_STOP);
+    }
+    _playing = false;
+}
+
+void Engine::StartClock()
+{
+    if (!_sendClock)
+    {
+        return;
+    }
+
+    // The clock starts on the next beat, or the one that just passed when
+    // that was less than half a pulse ago. From the start of the grid that
+    // is a Start, from anywhere else the position and a Continue, in both
+    // cases the next pulse is on the beat.
+    auto now = Now();
+    auto beat = StepAt(now);
+    if (StepTime(beat) < now - StepOffset(1, _milliBpm * PulsesPerBeat) / 2)
+    {
+        beat++;
+    }
+
+    auto time = StepTime(beat);
+    if (beat == 0)
+    {
+        SendRealtime(time, MIDI_START);
+    }
+    else
+    {
+        // In sixteenth notes, 14 bits
+        auto position = (beat * 4) & 0x3FFF;
+        const unsigned char songPosition[] = {
+            MIDI_SONG_POSITION,
+            static_cast<unsigned char>(position & 0x7F),
+            static_cast<unsigned char>(position >> 7),
+        };
+        Collect(time, songPosition, sizeof(songPosition));
+        SendRealtime(time, MIDI_CONTINUE);
+    }
+
+    _clockPulse = beat * PulsesPerBeat;
+}
+
+void Engine::Rebase()
+{
+    _origin = Now();
+    for (auto &ch : _channels)
+    {
+        ch._step = 0;
+    }
+    _tempoError = 0.0f;
+    _maxLateness = 0;
+    _missedSteps = 0;
+}
+
+long long Engine::Now() const
+{
+    return _clock->Now();
+}
+
+void Engine::SetClock(
+    Clock *clock)
+{
+    _clock = clock != nullptr ? clock : &_steadyClock;
+}
+
+long long Engine::StepTime(
+    long long step) const
+{
+    return _origin + StepOffset(step, _milliBpm);
+}
+
+long long Engine::PulseTime(
+    long long pulse) const
+{
+    return _origin + StepOffset(pulse, _milliBpm * PulsesPerBeat);
+}
+
+long long Engine::PulseAt(
+    long long time) const
+{
+    auto pulse = (time - _origin) / (NanosecondsPerBeat / (_milliBpm * PulsesPerBeat));
+
+    while (pulse > 0 && PulseTime(pulse) > time)
+    {
+        pulse--;
+    }
+    while (PulseTime(pulse + 1) <= time)
+    {
+        pulse++;
+    }
+
+    return pulse;
+}
+
+long long Engine::StepAt(
+    long long time) const
+{
+    auto step = (time - _origin) / (NanosecondsPerBeat / _milliBpm);
+
+    while (step > 0 && StepTime(step) > time)
+    {
+        step--;
+    }
+    while (StepTime(step + 1) <= time)
+    {
+        step++;
+    }
+
+    return step;
+}
+
+long long Engine::RunNotes()
+{
+    auto now = Now();
+
+    // Everything due before the horizon is handed to the sink now, a sink
+    // that schedules delivers it at its due time
+    auto lookahead = _sink != nullptr ? _sink->Lookahead() : 0;
+    auto horizon = now + lookahead;
+    auto nextDue = horizon + 100000000LL;
+
+    if (!_playing)
+    {
+        return nextDue - lookahead;
+    }
+
+    _sendAhead = lookahead;
+
+    if (_sendClock)
+    {
+        // Pulses are never dropped, a slave counts them for its position,
+        // but after falling more than a beat behind the clock starts over
+        // from the next beat
+        if (PulseAt(now) - _clockPulse > PulsesPerBeat)
+        {
+            StartClock();
+        }
+
+        while (horizon >= PulseTime(_clockPulse))
+        {
+            SendRealtime(PulseTime(_clockPulse), MIDI_CLOCK);
+            _clockPulse++;
+        }
+        nextDue = std::min(nextDue, PulseTime(_clockPulse));
+    }
+
+    for (auto &ch : _channels)
+    {
+        if (!ch._soundingNotes.Empty())
+        {
+            if (horizon >= ch._noteOffDue)
+            {
+                NotesOff(ch, ch._noteOffDue);
+            }
+            else
+            {
+                nextDue = std::min(nextDue, ch._noteOffDue);
+            }
+        }
+
+        if (ch._playOrder.empty())
+        {
+            // An idle channel joins the grid again at the next step
+            ch._step = StepAt(horizon) + 1;
+            continue;
+        }
+
+        if (ch._noteLength > 1.0f) ch._noteLength = 1.0f;
+        if (ch._noteLength <= 0.0f) ch._noteLength = 0.01f;
+
+        auto stepDue = StepTime(ch._step);
+
+        if (horizon >= stepDue)
+        {
+            auto time = std::max(stepDue, now);
+
+            NotesOff(ch, stepDue);
+
+            if (ch._currentNote >= ch._playOrder.size())
+            {
+                ch._currentNote = 0;
+            }
+
+            auto note = ch._playOrder[ch._currentNote];
+            Send(stepDue, MIDI_NOTE_ON | ch._channel, note, ch._velocity);
+            ch._soundingNotes.Set(note);
+
+            auto lateness = time - stepDue;
+            if (lateness > _maxLateness)
+            {
+                _maxLateness = lateness;
+            }
+
+            if (ch._step > 0)
+            {
+                _tempoError = float((double(NanosecondsPerBeat) * double(ch._step) / double(time - _origin) - double(_milliBpm)) / 1000.0);
+            }
+
+            // When we are more than a step behind the missed steps are
+            // dropped instead of fired in a burst, the grid itself stays
+            // where it was.
+            auto current = StepAt(now);
+            if (current > ch._step)
+            {
+                _missedSteps += current - ch._step;
+                ch._step = current;
+            }
+
+            auto firedStep = StepTime(ch._step);
+            ch._step++;
+            _changes.fetch_add(1, std::memory_order_relaxed);
+            ch._noteOffDue = firedStep + (long long)(double(StepTime(ch._step) - firedStep) * ch._noteLength);
+            nextDue = std::min(nextDue, ch._noteOffDue);
+
+            if (ch._arpMode == ArpModes::Up || ch._arpMode == ArpModes::Order)
+            {
+                ch._currentNote++;
+                if (ch._currentNote >= ch._playOrder.size())
+                {
+                    ch._currentNote = 0;
+                }
+            }
+            else if (ch._arpMode == ArpModes::Down)
+            {
+                if (ch._currentNote == 0)
+                {
+                    ch._currentNote = ch._playOrder.size() - 1;
+                }
+                else
+                {
+                    ch._currentNote--;
+                }
+            }
+            else if (ch._arpMode == ArpModes::Inclusive)
+            {
+                if (ch._direction < 0 && ch._currentNote == 0)
+                {
+                    ch._direction = 1;
+                }
+                else if (ch._direction > 0 && ch._currentNote + 1 >= ch._playOrder.size())
+                {
+                    ch._direction = -1;
+                }
+                else
+                {
+                    ch._currentNote += ch._direction;
+                }
+            }
+            else if (ch._arpMode == ArpModes::Exclusive)
+            {
+                if (ch._direction < 0 && ch._currentNote == 0)
+                {
+                    ch._direction = 1;
+                }
+                else if (ch._direction > 0 && ch._currentNote + 1 >= ch._playOrder.size())
+                {
+                    ch._direction = -1;
+                }
+
+                ch._currentNote += ch._direction;
+            }
+            else if (ch._arpMode == ArpModes::Random)
+            {
+                ch._currentNote = _random() % ch._playOrder.size();
+            }
+        }
+
+        nextDue = std::min(nextDue, StepTime(ch._step));
+    }
+
+    _sendAhead = 0;
+
+    return nextDue - lookahead;
+}
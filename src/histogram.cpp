@@ -0,0 +1,113 @@
+#include <histogram.hpp>
+
+#include <algorithm>
+
+void Histogram::Record(
+    long long nanoseconds)
+{
+    if (nanoseconds < 0)
+    {
+        nanoseconds = 0;
+    }
+
+    _buckets[Bucket(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+
+    // Only one thread writes, so this does not need a compare and swap
+    if (nanoseconds > _max.load(std::memory_order_relaxed))
+    {
+        _max.store(nanoseconds, std::memory_order_relaxed);
+    }
+}
+
+long long Histogram::Count() const
+{
+    return _count.load(std::memory_order_relaxed);
+}
+
+long long Histogram::Max() const
+{
+    return _max.load(std::memory_order_relaxed);
+}
+
+long long Histogram::Percentile(
+    double fraction) const
+{
+    // Counted from the buckets, the total may have moved on since
+    long long counts[Buckets];
+    long long total = 0;
+    for (int i = 0; i < Buckets; i++)
+    {
+        counts[i] = _buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+
+    if (total == 0)
+    {
+        return 0;
+    }
+
+    auto rank = (long long)(fraction * double(total) + 0.5);
+    rank = std::max(1LL, std::min(rank, total));
+
+    long long seen = 0;
+    for (int i = 0; i < Buckets; i++)
+    {
+        seen += counts[i];
+        if (seen >= rank)
+        {
+            return std::min(BucketLimit(i), Max());
+        }
+    }
+
+    return Max();
+}
+
+tHistogramSummary Histogram::Summary() const
+{
+    tHistogramSummary summary;
+
+    summary._count = Count();
+    summary._p50 = Percentile(0.5);
+    summary._p99 = Percentile(0.99);
+    summary._p999 = Percentile(0.999);
+    summary._max = Max();
+
+    return summary;
+}
+
+int Histogram::Bucket(
+    long long nanoseconds)
+{
+    auto microseconds = (unsigned long long)(nanoseconds / 1000);
+    if (microseconds < (unsigned long long)SubBuckets)
+    {
+        return int(microseconds);
+    }
+
+    // Power of two above the sub bucket range, 3 for 8 us
+    int power = 63;
+    while ((microseconds >> power) == 0)
+    {
+        power--;
+    }
+
+    auto sub = int((microseconds >> (power - 3)) & (SubBuckets - 1));
+    auto bucket = SubBuckets + (power - 3) * SubBuckets + sub;
+
+    return std::min(bucket, Buckets - 1);
+}
+
+long long Histogram::BucketLimit(
+    int bucket)
+{
+    if (bucket < SubBuckets)
+    {
+        return (bucket + 1) * 1000LL;
+    }
+
+    int power = (bucket - SubBuckets) / SubBuckets + 3;
+    int sub = (bucket - SubBuckets) % SubBuckets;
+
+    return ((long long)(SubBuckets + sub + 1) << (power - 3)) * 1000LL;
+}
@@ -0,0 +1,299 @@
+#include <clock.hpp>
+#include <jacksink.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+// Messages are handed over at least this far ahead, and at least two periods
+const long long MinimumLookahead = 5000000LL;
+
+// A relocation moves the beat grid by more than this
+const long long RelocateThreshold = 1000000LL;
+
+// Room in the queue only note-offs may take, so notes that were started can
+// always be stopped
+const size_t NoteOffReserve = 1024;
+
+static bool IsNoteOff(
+    const unsigned char *data,
+    unsigned char size)
+{
+    return size == 3 && ((data[0] & 0xF0) == 0x80 || ((data[0] & 0xF0) == 0x90 && data[2] == 0));
+}
+
+JackSink::JackSink() = default;
+
+JackSink::~JackSink()
+{
+    if (_client == nullptr)
+    {
+        return;
+    }
+
+    jack_deactivate(_client);
+    jack_client_close(_client);
+    _client = nullptr;
+
+    if (Dropped() > 0)
+    {
+        std::cerr << "JACK: " << Dropped() << " messages dropped, the queue to the process callback was full" << std::endl;
+    }
+}
+
+bool JackSink::Init()
+{
+    jack_status_t status;
+    _client = jack_client_open("arp", JackNoStartServer, &status);
+    if (_client == nullptr)
+    {
+        std::cerr << "Cannot connect to the JACK server, status 0x" << std::hex << int(status) << std::dec << std::endl;
+        return false;
+    }
+
+    _port = jack_port_register(_client, "midi_out", JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput, 0);
+    if (_port == nullptr)
+    {
+        std::cerr << "Cannot register a JACK midi port" << std::endl;
+        return false;
+    }
+
+    auto period = 1000000000LL * jack_get_buffer_size(_client) / jack_get_sample_rate(_client);
+    _lookahead = std::max(MinimumLookahead, 2 * period);
+
+    // Both clocks are monotonic, but not necessarily the same one
+    _clockOffset = SteadyClock().Now() - (long long)jack_get_time() * 1000LL;
+
+    jack_set_process_callback(_client, &JackSink::ProcessCallback, this);
+
+    if (jack_activate(_client) != 0)
+    {
+        std::cerr << "Cannot activate the JACK client" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+std::vector<std::string> JackSink::PortNames()
+{
+    _destinations.clear();
+
+    if (_client == nullptr)
+    {
+        return _destinations;
+    }
+
+    auto ports = jack_get_ports(_client, nullptr, JACK_DEFAULT_MIDI_TYPE, JackPortIsInput);
+    if (ports == nullptr)
+    {
+        return _destinations;
+    }
+
+    for (size_t i = 0; ports[i] != nullptr; i++)
+    {
+        _destinations.push_back(ports[i]);
+    }
+    jack_free(ports);
+
+    return _destinations;
+}
+
+void JackSink::OpenPort(
+    unsigned int port)
+{
+    if (_client == nullptr)
+    {
+        return;
+    }
+
+    if (_destinations.empty())
+    {
+        PortNames();
+    }
+
+    if (port >= _destinations.size())
+    {
+        std::cerr << "No JACK midi port " << port << std::endl;
+        return;
+    }
+
+    ClosePort();
+
+    if (jack_connect(_client, jack_port_name(_port), _destinations[port].c_str()) != 0)
+    {
+        std::cerr << "Cannot connect to JACK port " << _destinations[port] << std::endl;
+        return;
+    }
+
+    _connection = _destinations[port];
+}
+
+void JackSink::ClosePort()
+{
+    if (_connection.empty())
+    {
+        return;
+    }
+
+    jack_disconnect(_client, jack_port_name(_port), _connection.c_str());
+    _connection.clear();
+}
+
+long long JackSink::Lookahead() const
+{
+    return _lookahead;
+}
+
+void JackSink::Send(
+    long long time,
+    const unsigned char *message,
+    size_t size)
+{
+    if (_client == nullptr || size == 0 || size > 3)
+    {
+        return;
+    }
+
+    tQueuedMessage queued;
+    queued._time = time;
+    queued._generation = _generation.load(std::memory_order_relaxed);
+    std::copy(message, message + size, queued._data);
+    queued._size = static_cast<unsigned char>(size);
+
+    bool noteOff = IsNoteOff(queued._data, queued._size);
+    if ((!noteOff && _messages.Size() >= QueueCapacity - NoteOffReserve) || !_messages.Push(queued))
+    {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+long long JackSink::Dropped() const
+{
+    return _dropped.load(std::memory_order_relaxed);
+}
+
+void JackSink::DropPending()
+{
+    _generation.fetch_add(1, std::memory_order_release);
+}
+
+bool JackSink::PollTransport(
+    struct tExternalTransport &transport)
+{
+    bool changed = false;
+
+    while (_transportChanges.Pop(transport))
+    {
+        changed = true;
+    }
+
+    return changed;
+}
+
+int JackSink::ProcessCallback(
+    jack_nframes_t frames,
+    void *arg)
+{
+    static_cast<JackSink *>(arg)->Process(frames);
+
+    return 0;
+}
+
+void JackSink::Process(
+    jack_nframes_t frames)
+{
+    auto frameTime = jack_last_frame_time(_client);
+    auto cycleStart = (long long)jack_frames_to_time(_client, frameTime) * 1000LL + _clockOffset;
+    auto cycleEnd = (long long)jack_frames_to_time(_client, frameTime + frames) * 1000LL + _clockOffset;
+    auto cycleLength = std::max(1LL, cycleEnd - cycleStart);
+
+    FollowTransport(cycleStart);
+
+    auto buffer = jack_port_get_buffer(_port, frames);
+    jack_midi_clear_buffer(buffer);
+
+    auto generation = _generation.load(std::memory_order_acquire);
+
+    // JACK wants the events of a period in frame order, a message that
+    // comes in out of order goes at the frame of the one before it
+    jack_nframes_t lastOffset = 0;
+
+    tQueuedMessage message;
+    while (_holding || _messages.Pop(message))
+    {
+        if (_holding)
+        {
+            message = _held;
+            _holding = false;
+        }
+
+        bool dropped = message._generation != generation;
+        if (dropped && !IsNoteOff(message._data, message._size))
+        {
+            continue;
+        }
+
+        if (!dropped && message._time >= cycleEnd)
+        {
+            _held = message;
+            _holding = true;
+            break;
+        }
+
+        jack_nframes_t offset = 0;
+        if (message._time > cycleStart && !dropped)
+        {
+            offset = jack_nframes_t((message._time - cycleStart) * (long long)frames / cycleLength);
+        }
+        offset = std::max(lastOffset, std::min(offset, frames - 1));
+
+        jack_midi_event_write(buffer, offset, message._data, message._size);
+        lastOffset = offset;
+    }
+}
+
+void JackSink::FollowTransport(
+    long long cycleStart)
+{
+    jack_position_t position;
+    auto state = jack_transport_query(_client, &position);
+
+    tExternalTransport transport;
+    transport._rolling = state == JackTransportRolling;
+
+    if ((position.valid & JackPositionBBT) != 0 && position.beats_per_minute > 0.0)
+    {
+        // Beats counted from the start of the song, the arp steps on them
+        transport._milliBpm = std::llround(position.beats_per_minute * 1000.0);
+        transport._beat = std::llround((position.bar - 1) * position.beats_per_bar) + (position.beat - 1);
+
+        auto beatLength = 60000000000.0 / position.beats_per_minute;
+        transport._beatTime = cycleStart - (long long)(beatLength * position.tick / position.ticks_per_beat);
+    }
+    else
+    {
+        // No timebase master, the engine's own tempo counts from frame 0
+        transport._beatTime = cycleStart - (long long)(1000000000.0 * position.frame / position.frame_rate);
+    }
+
+    bool changed = transport._rolling != _transport._rolling || transport._milliBpm != _transport._milliBpm;
+
+    if (!changed && transport._rolling)
+    {
+        // Only a jump of the grid counts, not moving on to the next beat
+        auto expected = _transport._beatTime;
+        if (transport._milliBpm > 0)
+        {
+            expected += (long long)(60000000000000.0 * double(transport._beat - _transport._beat) / double(transport._milliBpm));
+        }
+        changed = std::llabs(transport._beatTime - expected) > RelocateThreshold;
+    }
+
+    if (changed && _transportChanges.Push(transport))
+    {
+        _transport = transport;
+        TransportChanged();
+    }
+}
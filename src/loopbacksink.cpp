@@ -0,0 +1,64 @@
+#include <loopbacksink.hpp>
+
+#include <algorithm>
+
+LoopbackSink::LoopbackSink(
+    long long lookahead)
+    : _lookahead(lookahead)
+{}
+
+bool LoopbackSink::Init()
+{
+    return true;
+}
+
+std::vector<std::string> LoopbackSink::PortNames()
+{
+    return {"loopback"};
+}
+
+void LoopbackSink::OpenPort(
+    unsigned int port)
+{
+    (void)port;
+}
+
+void LoopbackSink::ClosePort()
+{}
+
+long long LoopbackSink::Lookahead() const
+{
+    return _lookahead;
+}
+
+void LoopbackSink::Send(
+    long long time,
+    const unsigned char *message,
+    size_t size)
+{
+    if (size == 0 || size > 3)
+    {
+        return;
+    }
+
+    tMidiMessage looped;
+    looped._time = time;
+    std::copy(message, message + size, looped._data);
+    looped._size = static_cast<unsigned char>(size);
+
+    if (!_messages.Push(looped))
+    {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool LoopbackSink::Receive(
+    struct tMidiMessage &message)
+{
+    return _messages.Pop(message);
+}
+
+long long LoopbackSink::Dropped() const
+{
+    return _dropped.load(std::memory_order_relaxed);
+}
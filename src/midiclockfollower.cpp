@@ -0,0 +1,166 @@
+#include <midiclockfollower.hpp>
+
+#include <cmath>
+
+const unsigned char MIDI_CLOCK = 0xF8;
+const unsigned char MIDI_START = 0xFA;
+const unsigned char MIDI_CONTINUE = 0xFB;
+const unsigned char MIDI_STOP = 0xFC;
+const unsigned char MIDI_SONG_POSITION = 0xF2;
+
+// Loop gains, the period gain is a quarter of the square of the phase gain
+// so the loop is critically damped. Lower gains are smoother but take
+// longer to follow a tempo change.
+const double PhaseGain = 0.125;
+const double PeriodGain = PhaseGain * PhaseGain / 4.0;
+
+// Nanoseconds per beat at 1 milli-BPM, as in the engine
+const double NanosecondsPerMilliBpmBeat = 60000000000000.0;
+
+// Slowest clock we lock to, 24 pulses at 10 BPM
+const long long MaximumPulseGap = 250000000LL;
+
+bool MidiClockFollower::Receive(
+    long long time,
+    const unsigned char *message,
+    size_t size,
+    struct tExternalTransport &transport)
+{
+    if (size == 0)
+    {
+        return false;
+    }
+
+    switch (message[0])
+    {
+        case MIDI_START:
+        {
+            _songPosition = 0;
+            _pulse = 0;
+            _waitingForPulse = true;
+            return false;
+        }
+        case MIDI_CONTINUE:
+        {
+            _pulse = _songPosition;
+            _waitingForPulse = true;
+            return false;
+        }
+        case MIDI_STOP:
+        {
+            _waitingForPulse = false;
+            _songPosition = _pulse;
+            if (!_rolling)
+            {
+                return false;
+            }
+            _rolling = false;
+            transport = tExternalTransport();
+            return true;
+        }
+        case MIDI_SONG_POSITION:
+        {
+            // In sixteenth notes, six pulses each
+            if (size == 3)
+            {
+                _songPosition = ((long long)message[1] | ((long long)message[2] << 7)) * 6;
+                if (!_rolling)
+                {
+                    _pulse = _songPosition;
+                }
+            }
+            return false;
+        }
+        case MIDI_CLOCK:
+        {
+            break;
+        }
+        default:
+        {
+            return false;
+        }
+    }
+
+    auto pulseTime = Pulse(time);
+
+    bool started = _waitingForPulse;
+    if (started)
+    {
+        _waitingForPulse = false;
+        _rolling = true;
+    }
+
+    if (!_rolling)
+    {
+        return false;
+    }
+
+    auto pulse = _pulse++;
+    auto beatPulse = pulse % PulsesPerBeat;
+
+    // Realign on every beat, and right away when playing starts
+    if (!started && beatPulse != 0)
+    {
+        return false;
+    }
+
+    transport._rolling = true;
+    transport._milliBpm = MilliBpm();
+    transport._beat = pulse / PulsesPerBeat;
+    transport._beatTime = (long long)(pulseTime - double(beatPulse) * _period);
+
+    return true;
+}
+
+void MidiClockFollower::Reset()
+{
+    *this = MidiClockFollower();
+}
+
+long long MidiClockFollower::MilliBpm() const
+{
+    if (_period <= 0.0)
+    {
+        return 0;
+    }
+
+    return std::llround(NanosecondsPerMilliBpmBeat / (_period * PulsesPerBeat));
+}
+
+double MidiClockFollower::Pulse(
+    long long time)
+{
+    auto gap = time - _lastPulse;
+    _lastPulse = time;
+
+    // (Re)lock on the first two pulses after a gap
+    if (gap <= 0 || gap > MaximumPulseGap)
+    {
+        _period = 0.0;
+        _expected = 0.0;
+        return double(time);
+    }
+
+    if (_period <= 0.0)
+    {
+        _period = double(gap);
+        _expected = double(time) + _period;
+        return double(time);
+    }
+
+    auto error = double(time) - _expected;
+
+    // A jump of half a pulse or more is a new tempo, not jitter
+    if (std::fabs(error) >= _period / 2.0)
+    {
+        _period = double(gap);
+        _expected = double(time) + _period;
+        return double(time);
+    }
+
+    auto pulseTime = _expected + PhaseGain * error;
+    _period += PeriodGain * error;
+    _expected = pulseTime + _period;
+
+    return pulseTime;
+}
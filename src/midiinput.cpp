@@ -0,0 +1,108 @@
+#include <midiinput.hpp>
+
+MidiInput::MidiInput(
+    Engine &engine,
+    RtMidi::Api api)
+    : _engine(engine),
+      _api(api)
+{}
+
+MidiInput::~MidiInput()
+{
+    ClosePort();
+    delete _midiin;
+    _midiin = nullptr;
+}
+
+bool MidiInput::Init()
+{
+    try
+    {
+        _midiin = new RtMidiIn(_api);
+    }
+    catch (RtMidiError &error)
+    {
+        error.printMessage();
+        return false;
+    }
+
+    _midiin->setCallback(&MidiInput::Received, this);
+
+    // Let clock and transport messages through, the engine may follow them
+    _midiin->ignoreTypes(true, false, true);
+
+    return true;
+}
+
+std::vector<std::string> MidiInput::PortNames()
+{
+    std::vector<std::string> names;
+
+    if (_midiin == nullptr)
+    {
+        return names;
+    }
+
+    auto ports = _midiin->getPortCount();
+
+    for (unsigned int i = 0; i < ports; i++)
+    {
+        try
+        {
+            names.push_back(_midiin->getPortName(i));
+        }
+        catch (RtMidiError &error)
+        {
+            error.printMessage();
+        }
+    }
+
+    return names;
+}
+
+void MidiInput::OpenPort(
+    unsigned int port)
+{
+    if (_midiin == nullptr)
+    {
+        return;
+    }
+
+    try
+    {
+        ClosePort();
+        _midiin->openPort(port);
+    }
+    catch (RtMidiError &error)
+    {
+        error.printMessage();
+    }
+}
+
+void MidiInput::ClosePort()
+{
+    if (_midiin != nullptr && _midiin->isPortOpen())
+    {
+        _midiin->closePort();
+    }
+}
+
+long long MidiInput::Dropped() const
+{
+    return _dropped.load();
+}
+
+void MidiInput::Received(
+    double deltaTime,
+    std::vector<unsigned char> *message,
+    void *userData)
+{
+    (void)deltaTime;
+
+    auto input = static_cast<MidiInput *>(userData);
+
+    if (!input->_engine.Receive(input->_clock.Now(), message->data(), message->size()))
+    {
+        input->_dropped++;
+    }
+}
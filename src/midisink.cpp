@@ -0,0 +1,196 @@
+#include <capturesink.hpp>
+#include <midisink.hpp>
+#include <nullsink.hpp>
+
+#ifdef ARP_WITH_ALSA_SEQ
+#include <alsaseqsink.hpp>
+#endif
+
+#ifdef ARP_WITH_JACK
+#include <jacksink.hpp>
+#endif
+
+MidiSink::~MidiSink() = default;
+
+long long MidiSink::Lookahead() const
+{
+    return 0;
+}
+
+void MidiSink::SendBatch(
+    const struct tMidiMessage *messages,
+    size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        Send(messages[i]._time, messages[i]._data, messages[i]._size);
+    }
+}
+
+void MidiSink::DropPending()
+{}
+
+bool MidiSink::PollTransport(
+    struct tExternalTransport &transport)
+{
+    (void)transport;
+
+    return false;
+}
+
+void MidiSink::SetTransportCallback(
+    TransportCallback callback,
+    void *arg)
+{
+    // The sink's thread may already be running, it sees the argument
+    // before the callback
+    _transportCallbackArg.store(arg, std::memory_order_relaxed);
+    _transportCallback.store(callback, std::memory_order_release);
+}
+
+void MidiSink::TransportChanged()
+{
+    auto callback = _transportCallback.load(std::memory_order_acquire);
+    if (callback != nullptr)
+    {
+        callback(_transportCallbackArg.load(std::memory_order_relaxed));
+    }
+}
+
+RtMidiSink::RtMidiSink(
+    RtMidi::Api api)
+    : _api(api)
+{}
+
+RtMidiSink::~RtMidiSink()
+{
+    ClosePort();
+    delete _midiout;
+    _midiout = nullptr;
+}
+
+bool RtMidiSink::Init()
+{
+    try
+    {
+        _midiout = new RtMidiOut(_api);
+    }
+    catch (RtMidiError &error)
+    {
+        error.printMessage();
+        return false;
+    }
+
+    return true;
+}
+
+std::vector<std::string> RtMidiSink::PortNames()
+{
+    std::vector<std::string> names;
+
+    auto ports = _midiout->getPortCount();
+
+    for (unsigned int i = 0; i < ports; i++)
+    {
+        try
+        {
+            names.push_back(_midiout->getPortName(i));
+        }
+        catch (RtMidiError &error)
+        {
+            error.printMessage();
+        }
+    }
+
+    return names;
+}
+
+void RtMidiSink::OpenPort(
+    unsigned int port)
+{
+    try
+    {
+        ClosePort();
+        _midiout->openPort(port);
+    }
+    catch (RtMidiError &error)
+    {
+        error.printMessage();
+    }
+}
+
+void RtMidiSink::ClosePort()
+{
+    if (_midiout != nullptr && _midiout->isPortOpen())
+    {
+        _midiout->closePort();
+    }
+}
+
+void RtMidiSink::Send(
+    long long time,
+    const unsigned char *message,
+    size_t size)
+{
+    (void)time;
+
+    if (_midiout->isPortOpen())
+    {
+        _midiout->sendMessage(message, size);
+    }
+}
+
+std::vector<std::string> MidiSinkBackends()
+{
+    return {
+#ifdef ARP_WITH_ALSA_SEQ
+        "alsa",
+#endif
+        "rtmidi",
+#ifdef ARP_WITH_JACK
+        "jack",
+#endif
+        "null",
+        "capture",
+    };
+}
+
+MidiSink *CreateMidiSink(
+    const std::string &backend)
+{
+#ifdef ARP_WITH_ALSA_SEQ
+    if (backend == "alsa")
+    {
+        return new AlsaSeqSink();
+    }
+#endif
+
+    if (backend == "rtmidi")
+    {
+        return new RtMidiSink();
+    }
+
+#ifdef ARP_WITH_JACK
+    if (backend == "jack")
+    {
+        return new JackSink();
+    }
+#endif
+
+    if (backend == "null")
+    {
+        return new NullSink();
+    }
+
+    if (backend == "capture")
+    {
+        return new CaptureSink(CaptureSink::DefaultPath);
+    }
+
+    if (backend.compare(0, 8, "capture:") == 0 && backend.size() > 8)
+    {
+        return new CaptureSink(backend.substr(8));
+    }
+
+    return nullptr;
+}
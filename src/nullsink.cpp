@@ -0,0 +1,56 @@
+#include <nullsink.hpp>
+
+bool NullSink::Init()
+{
+    return true;
+}
+
+std::vector<std::string> NullSink::PortNames()
+{
+    return {"null"};
+}
+
+void NullSink::OpenPort(
+    unsigned int port)
+{
+    (void)port;
+}
+
+void NullSink::ClosePort()
+{}
+
+void NullSink::Send(
+    long long time,
+    const unsigned char *message,
+    size_t size)
+{
+    (void)time;
+    (void)message;
+
+    _messages.fetch_add(1, std::memory_order_relaxed);
+    _bytes.fetch_add((long long)size, std::memory_order_relaxed);
+}
+
+void NullSink::SendBatch(
+    const struct tMidiMessage *messages,
+    size_t count)
+{
+    long long bytes = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        bytes += messages[i]._size;
+    }
+
+    _messages.fetch_add((long long)count, std::memory_order_relaxed);
+    _bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+long long NullSink::Messages() const
+{
+    return _messages.load(std::memory_order_relaxed);
+}
+
+long long NullSink::Bytes() const
+{
+    return _bytes.load(std::memory_order_relaxed);
+}
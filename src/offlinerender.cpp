@@ -0,0 +1,116 @@
+#include <offlinerender.hpp>
+#include <smf.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+OfflineRenderer::EventSink::EventSink(
+    std::vector<tRenderedEvent> &events)
+    : _events(events)
+{}
+
+bool OfflineRenderer::EventSink::Init()
+{
+    return true;
+}
+
+std::vector<std::string> OfflineRenderer::EventSink::PortNames()
+{
+    return {};
+}
+
+void OfflineRenderer::EventSink::OpenPort(
+    unsigned int port)
+{
+    (void)port;
+}
+
+void OfflineRenderer::EventSink::ClosePort()
+{}
+
+void OfflineRenderer::EventSink::Send(
+    long long time,
+    const unsigned char *message,
+    size_t size)
+{
+    // Clock and other system messages have no place in the event list or
+    // a track of the SMF
+    if (size != 3 || message[0] >= 0xF0)
+    {
+        return;
+    }
+
+    _events.push_back({time, {message[0], message[1], message[2]}});
+}
+
+OfflineRenderer::OfflineRenderer()
+{
+    SetClock(&_virtualClock);
+    _sink = &_eventSink;
+}
+
+void OfflineRenderer::Render(
+    const struct tSession &session,
+    int bars)
+{
+    _virtualClock.Set(0);
+    for (auto &command : SessionCommands(session))
+    {
+        Apply(command);
+    }
+
+    Apply({EngineCommandTypes::SetPlaying, 0, 0, 1});
+
+    auto end = StepTime(bars * StepsPerBar);
+    while (Now() < end)
+    {
+        auto nextDue = RunNotes();
+        Flush();
+        _virtualClock.Set(std::min(std::max(nextDue, Now() + 1), end));
+    }
+
+    Apply({EngineCommandTypes::SetPlaying, 0, 0, 0});
+    Flush();
+}
+
+const std::vector<tRenderedEvent> &OfflineRenderer::Events() const
+{
+    return _events;
+}
+
+bool OfflineRenderer::WriteSmf(
+    const std::string &path,
+    std::string &error) const
+{
+    SmfWriter smf(TicksPerQuarter);
+    smf.SetTempo(_milliBpm);
+
+    size_t tracks[16] = {0};
+    for (auto &event : _events)
+    {
+        auto channel = event._data[0] & 0x0F;
+        if (tracks[channel] == 0)
+        {
+            tracks[channel] = smf.AddTrack("Channel " + std::to_string(channel + 1));
+        }
+
+        auto tick = std::llround(double(event._time) * TicksPerQuarter * double(_milliBpm) / double(NanosecondsPerBeat));
+        smf.AddEvent(tracks[channel], tick, event._data[0], event._data[1], event._data[2]);
+    }
+
+    return smf.Write(path, error);
+}
+
+void OfflineRenderer::WriteEventList(
+    std::ostream &out) const
+{
+    for (auto &event : _events)
+    {
+        out << event._time << std::hex << std::setfill('0')
+            << " " << std::setw(2) << int(event._data[0])
+            << " " << std::setw(2) << int(event._data[1])
+            << " " << std::setw(2) << int(event._data[2])
+            << std::dec << "\n";
+    }
+}
@@ -0,0 +1,191 @@
+#include <realtime.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+bool ParseRealtimeOption(
+    const std::vector<std::string> &args,
+    size_t &i,
+    struct tRealtimeOptions &options)
+{
+    bool hasValue = i + 1 < args.size();
+
+    if (args[i] == "--rt-policy" && hasValue)
+    {
+        auto &policy = args[++i];
+        if (policy == "fifo")
+        {
+            options._policy = SchedulingPolicies::Fifo;
+        }
+        else if (policy == "rr")
+        {
+            options._policy = SchedulingPolicies::RoundRobin;
+        }
+        else
+        {
+            options._policy = SchedulingPolicies::Default;
+        }
+        return true;
+    }
+
+    if (args[i] == "--rt-priority" && hasValue)
+    {
+        options._priority = std::atoi(args[++i].c_str());
+        return true;
+    }
+
+    if (args[i] == "--rt-cpu" && hasValue)
+    {
+        options._cpu = std::atoi(args[++i].c_str());
+        return true;
+    }
+
+    if (args[i] == "--mlock")
+    {
+        options._lockMemory = true;
+        return true;
+    }
+
+    if (args[i] == "--spin-us" && hasValue)
+    {
+        options._spinWindow = std::atoll(args[++i].c_str()) * 1000LL;
+        return true;
+    }
+
+    if (args[i] == "--prefault-stack" && hasValue)
+    {
+        options._stackPrefault = size_t(std::atoll(args[++i].c_str())) * 1024;
+        return true;
+    }
+
+    return false;
+}
+
+const char *RealtimeUsage()
+{
+    return "    --rt-policy <p> engine thread scheduling, fifo or rr\n"
+           "    --rt-priority <n> priority for fifo or rr, 70 by default\n"
+           "    --rt-cpu <n>    pin the engine thread to this core\n"
+           "    --mlock         lock all memory of the process\n"
+           "    --prefault-stack <KiB> touch this much stack before playing\n"
+           "    --spin-us <n>   spin instead of sleep for the last n microseconds before an event\n";
+}
+
+#ifdef _WIN32
+
+std::vector<std::string> ApplyRealtime(
+    std::thread &thread,
+    const struct tRealtimeOptions &options)
+{
+    std::vector<std::string> problems;
+    auto handle = thread.native_handle();
+
+    if (options._policy != SchedulingPolicies::Default && !SetThreadPriority(handle, THREAD_PRIORITY_TIME_CRITICAL))
+    {
+        problems.push_back("Cannot raise the engine thread to time critical priority");
+    }
+
+    if (options._cpu >= 0 && SetThreadAffinityMask(handle, DWORD_PTR(1) << options._cpu) == 0)
+    {
+        problems.push_back("Cannot pin the engine thread to CPU " + std::to_string(options._cpu));
+    }
+
+    if (options._lockMemory)
+    {
+        problems.push_back("Locking memory is not supported on Windows");
+    }
+
+    return problems;
+}
+
+#else
+
+std::vector<std::string> ApplyRealtime(
+    std::thread &thread,
+    const struct tRealtimeOptions &options)
+{
+    std::vector<std::string> problems;
+    auto handle = thread.native_handle();
+
+    if (options._policy != SchedulingPolicies::Default)
+    {
+        int policy = options._policy == SchedulingPolicies::Fifo ? SCHED_FIFO : SCHED_RR;
+        const char *name = options._policy == SchedulingPolicies::Fifo ? "SCHED_FIFO" : "SCHED_RR";
+
+        sched_param param;
+        std::memset(&param, 0, sizeof(param));
+        param.sched_priority = std::max(sched_get_priority_min(policy), std::min(options._priority, sched_get_priority_max(policy)));
+
+        auto result = pthread_setschedparam(handle, policy, &param);
+        if (result == EPERM)
+        {
+            problems.push_back(std::string("Not permitted to use ") + name + " priority " + std::to_string(param.sched_priority) +
+                               ", raise rtprio in /etc/security/limits.conf, join the audio group or grant CAP_SYS_NICE");
+        }
+        else if (result != 0)
+        {
+            problems.push_back(std::string("Cannot set ") + name + " priority " + std::to_string(param.sched_priority) + ": " + std::strerror(result));
+        }
+    }
+
+    if (options._cpu >= 0)
+    {
+#ifdef __linux__
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(options._cpu, &cpus);
+
+        auto result = pthread_setaffinity_np(handle, sizeof(cpus), &cpus);
+        if (result != 0)
+        {
+            problems.push_back("Cannot pin the engine thread to CPU " + std::to_string(options._cpu) + ": " + std::strerror(result));
+        }
+#else
+        problems.push_back("Pinning the engine thread to a CPU is not supported on this platform");
+#endif
+    }
+
+    if (options._lockMemory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        auto error = errno;
+        if (error == EPERM || error == ENOMEM)
+        {
+            problems.push_back("Not permitted to lock memory, raise memlock in /etc/security/limits.conf (ulimit -l) or grant CAP_IPC_LOCK");
+        }
+        else
+        {
+            problems.push_back(std::string("Cannot lock memory: ") + std::strerror(error));
+        }
+    }
+
+    return problems;
+}
+
+#endif
+
+void PrefaultStack(
+    size_t bytes)
+{
+    // One page per call. The page is written after the deeper calls return,
+    // so the recursion cannot be turned into a loop that reuses one frame.
+    const size_t chunk = 4096;
+    volatile unsigned char page[chunk];
+
+    if (bytes > chunk)
+    {
+        PrefaultStack(bytes - chunk);
+    }
+
+    page[0] = 0;
+    page[chunk - 1] = page[0];
+}
@@ -0,0 +1,216 @@
+#include <session.hpp>
+
+#include <fstream>
+#include <sstream>
+
+bool ParseArpMode(
+    const std::string &name,
+    int &arpMode)
+{
+    const char *names[] = {
+        "up",
+        "down",
+        "inclusive",
+        "exclusive",
+        "random",
+        "order",
+    };
+
+    for (int i = 0; i < 6; i++)
+    {
+        if (name == names[i])
+        {
+            arpMode = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool LoadSession(
+    const std::string &path,
+    struct tSession &session,
+    std::string &error)
+{
+    std::ifstream file(path);
+
+    if (!file.is_open())
+    {
+        error = "Unable to open " + path;
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+
+        auto comment = line.find('#');
+        if (comment != std::string::npos)
+        {
+            line = line.substr(0, comment);
+        }
+
+        std::istringstream words(line);
+        std::string key;
+        if (!(words >> key))
+        {
+            continue;
+        }
+
+        std::stringstream location;
+        location << path << ":" << lineNumber << ": ";
+
+        if (key == "bpm")
+        {
+            if (!(words >> session._bpm) || session._bpm <= 0.0f)
+            {
+                error = location.str() + "expected a tempo";
+                return false;
+            }
+            continue;
+        }
+
+        if (key == "port")
+        {
+            if (!(words >> session._port))
+            {
+                error = location.str() + "expected a port number";
+                return false;
+            }
+            continue;
+        }
+
+        if (key == "seed")
+        {
+            if (!(words >> session._seed))
+            {
+                error = location.str() + "expected a seed";
+                return false;
+            }
+            continue;
+        }
+
+        if (key == "channel")
+        {
+            if (session._channels.size() == Engine::MaxChannels)
+            {
+                error = location.str() + "more than " + std::to_string(Engine::MaxChannels) + " channels";
+                return false;
+            }
+
+            tSessionChannel channel;
+            std::getline(words >> std::ws, channel._name);
+            session._channels.push_back(channel);
+            continue;
+        }
+
+        if (session._channels.empty())
+        {
+            error = location.str() + "\"" + key + "\" before the first channel";
+            return false;
+        }
+
+        auto &ch = session._channels.back();
+
+        if (key == "midi")
+        {
+            int midiChannel = 0;
+            if (!(words >> midiChannel) || midiChannel < 1 || midiChannel > 16)
+            {
+                error = location.str() + "expected a midi channel from 1 to 16";
+                return false;
+            }
+            ch._channel = static_cast<unsigned char>(midiChannel - 1);
+        }
+        else if (key == "mode")
+        {
+            std::string mode;
+            if (!(words >> mode) || !ParseArpMode(mode, ch._arpMode))
+            {
+                error = location.str() + "expected up, down, inclusive, exclusive, random or order";
+                return false;
+            }
+        }
+        else if (key == "velocity")
+        {
+            int velocity = 0;
+            if (!(words >> velocity) || velocity < 0 || velocity > 127)
+            {
+                error = location.str() + "expected a velocity from 0 to 127";
+                return false;
+            }
+            ch._velocity = static_cast<unsigned char>(velocity);
+        }
+        else if (key == "length")
+        {
+            if (!(words >> ch._noteLength) || ch._noteLength <= 0.0f || ch._noteLength > 1.0f)
+            {
+                error = location.str() + "expected a note length from 0 to 1";
+                return false;
+            }
+        }
+        else if (key == "notes")
+        {
+            int note = 0;
+            while (words >> note)
+            {
+                if (note < 0 || note > 127)
+                {
+                    error = location.str() + "notes must be from 0 to 127";
+                    return false;
+                }
+                ch._notes.push_back(static_cast<unsigned char>(note));
+            }
+        }
+        else
+        {
+            error = location.str() + "unknown setting \"" + key + "\"";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+std::vector<tEngineCommand> SessionCommands(
+    const struct tSession &session)
+{
+    std::vector<tEngineCommand> commands;
+
+    commands.push_back({EngineCommandTypes::SetBpm, 0, 0, 0, session._bpm});
+    commands.push_back({EngineCommandTypes::SetSeed, 0, 0, session._seed});
+
+    for (size_t i = 0; i < session._channels.size(); i++)
+    {
+        auto &ch = session._channels[i];
+
+        commands.push_back({EngineCommandTypes::AddChannel});
+        commands.push_back({EngineCommandTypes::SetMidiChannel, i, 0, ch._channel});
+        commands.push_back({EngineCommandTypes::SetArpMode, i, 0, ch._arpMode});
+        commands.push_back({EngineCommandTypes::SetVelocity, i, 0, ch._velocity});
+        commands.push_back({EngineCommandTypes::SetNoteLength, i, 0, 0, ch._noteLength});
+
+        for (auto note : ch._notes)
+        {
+            commands.push_back({EngineCommandTypes::AddNote, i, note});
+        }
+    }
+
+    return commands;
+}
+
+void PostSession(
+    Engine &engine,
+    const struct tSession &session)
+{
+    // A session can hold more commands than fit in the engine's queue at
+    // once
+    for (auto &command : SessionCommands(session))
+    {
+        engine.PostWaiting(command);
+    }
+}
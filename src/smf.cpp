@@ -0,0 +1,151 @@
+#include <smf.hpp>
+
+#include <algorithm>
+#include <fstream>
+
+static void WriteVariableLength(
+    std::vector<unsigned char> &out,
+    unsigned long value)
+{
+    unsigned char bytes[5];
+    int count = 0;
+
+    do
+    {
+        bytes[count++] = value & 0x7F;
+        value >>= 7;
+    } while (value != 0);
+
+    while (count > 1)
+    {
+        out.push_back(bytes[--count] | 0x80);
+    }
+    out.push_back(bytes[0]);
+}
+
+static void WriteChunk(
+    std::ofstream &file,
+    const char *id,
+    const std::vector<unsigned char> &data)
+{
+    auto size = data.size();
+    const unsigned char length[] = {
+        (unsigned char)(size >> 24),
+        (unsigned char)(size >> 16),
+        (unsigned char)(size >> 8),
+        (unsigned char)size,
+    };
+
+    file.write(id, 4);
+    file.write(reinterpret_cast<const char *>(length), 4);
+    file.write(reinterpret_cast<const char *>(data.data()), std::streamsize(size));
+}
+
+SmfWriter::SmfWriter(
+    int ticksPerQuarter)
+    : _ticksPerQuarter(ticksPerQuarter)
+{
+    _tracks.push_back(tTrack());
+}
+
+size_t SmfWriter::AddTrack(
+    const std::string &name)
+{
+    tTrack track;
+    track._name = name;
+    _tracks.push_back(track);
+
+    return _tracks.size() - 1;
+}
+
+void SmfWriter::SetTempo(
+    long long milliBpm)
+{
+    _milliBpm = milliBpm;
+}
+
+void SmfWriter::AddEvent(
+    size_t track,
+    long long tick,
+    unsigned char status,
+    unsigned char data1,
+    unsigned char data2)
+{
+    _tracks[track]._events.push_back({tick, {status, data1, data2}});
+}
+
+bool SmfWriter::Write(
+    const std::string &path,
+    std::string &error) const
+{
+    std::ofstream file(path, std::ios::binary);
+
+    if (!file.is_open())
+    {
+        error = "Unable to open " + path;
+        return false;
+    }
+
+    const unsigned char header[] = {
+        0, 1, // format 1
+        (unsigned char)(_tracks.size() >> 8),
+        (unsigned char)_tracks.size(),
+        (unsigned char)(_ticksPerQuarter >> 8),
+        (unsigned char)_ticksPerQuarter,
+    };
+    WriteChunk(file, "MThd", std::vector<unsigned char>(header, header + sizeof(header)));
+
+    for (size_t i = 0; i < _tracks.size(); i++)
+    {
+        auto &track = _tracks[i];
+        std::vector<unsigned char> data;
+
+        if (i == 0)
+        {
+            // 4/4, then the tempo in microseconds per quarter note
+            auto microseconds = (60000000000LL + _milliBpm / 2) / _milliBpm;
+            const unsigned char meta[] = {
+                0, 0xFF, 0x58, 4, 4, 2, 24, 8,
+                0, 0xFF, 0x51, 3,
+                (unsigned char)(microseconds >> 16),
+                (unsigned char)(microseconds >> 8),
+                (unsigned char)microseconds,
+            };
+            data.insert(data.end(), meta, meta + sizeof(meta));
+        }
+        else
+        {
+            data.push_back(0);
+            data.push_back(0xFF);
+            data.push_back(0x03);
+            WriteVariableLength(data, track._name.size());
+            data.insert(data.end(), track._name.begin(), track._name.end());
+        }
+
+        auto events = track._events;
+        std::stable_sort(events.begin(), events.end(), [](const tEvent &a, const tEvent &b) {
+            return a._tick < b._tick;
+        });
+
+        long long lastTick = 0;
+        for (auto &event : events)
+        {
+            WriteVariableLength(data, (unsigned long)(event._tick - lastTick));
+            data.insert(data.end(), event._data, event._data + 3);
+            lastTick = event._tick;
+        }
+
+        const unsigned char endOfTrack[] = {0, 0xFF, 0x2F, 0};
+        data.insert(data.end(), endOfTrack, endOfTrack + sizeof(endOfTrack));
+
+        WriteChunk(file, "MTrk", data);
+    }
+
+    if (!file.good())
+    {
+        error = "Unable to write " + path;
+        return false;
+    }
+
+    return true;
+}
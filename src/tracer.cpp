@@ -0,0 +1,135 @@
+#include <tracer.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+// How often the writer thread empties the queues
+const std::chrono::milliseconds WriteInterval(50);
+
+static const char *TrackNames[TrackCount] = {"ui", "engine"};
+
+Tracer::Tracer() = default;
+
+Tracer::~Tracer()
+{
+    Close();
+}
+
+bool Tracer::Open(
+    const std::string &path)
+{
+    Close();
+
+    _file.open(path, std::ios::out | std::ios::trunc);
+    if (!_file.is_open())
+    {
+        std::cerr << "Cannot open trace file " << path << std::endl;
+        return false;
+    }
+
+    _origin = _clock.Now();
+    _dropped = 0;
+
+    _file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    for (int i = 0; i < TrackCount; i++)
+    {
+        _file << (i == 0 ? "" : ",\n")
+              << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i
+              << ",\"args\":{\"name\":\"" << TrackNames[i] << "\"}}";
+    }
+
+    _running = true;
+    _writer = std::thread(&Tracer::Write, this);
+    _enabled = true;
+
+    return true;
+}
+
+void Tracer::Close()
+{
+    if (!_running)
+    {
+        return;
+    }
+
+    // Threads that are still recording only lose their last events
+    _enabled = false;
+    _running = false;
+    _writer.join();
+
+    Drain();
+    _file << "\n]}\n";
+    _file.close();
+
+    if (_dropped > 0)
+    {
+        std::cerr << "Trace dropped " << _dropped << " events" << std::endl;
+    }
+}
+
+bool Tracer::Enabled() const
+{
+    return _enabled.load(std::memory_order_relaxed);
+}
+
+void Tracer::Record(
+    int track,
+    const char *name,
+    long long start,
+    long long end)
+{
+    if (!_enabled.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    if (!_tracks[track].Push({name, start, end}))
+    {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+long long Tracer::Now() const
+{
+    return _clock.Now();
+}
+
+long long Tracer::Dropped() const
+{
+    return _dropped.load(std::memory_order_relaxed);
+}
+
+void Tracer::Write()
+{
+    while (_running)
+    {
+        std::this_thread::sleep_for(WriteInterval);
+        Drain();
+        _file.flush();
+    }
+}
+
+void Tracer::Drain()
+{
+    char line[192];
+    tTraceEvent event;
+
+    for (int i = 0; i < TrackCount; i++)
+    {
+        while (_tracks[i].Pop(event))
+        {
+            // Chrome trace times are in microseconds, the thread names
+            // always come first so every event follows a comma
+            std::snprintf(
+                line,
+                sizeof(line),
+                ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                event._name,
+                i,
+                (event._start - _origin) / 1000.0,
+                (event._end - event._start) / 1000.0);
+            _file << line;
+        }
+    }
+}
@@ -0,0 +1,166 @@
+#include <waketimer.hpp>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static long long SteadyNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Tells the core we are spinning, so a hyperthread sibling gets the cycles
+static void Relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+#ifdef __linux__
+
+// The steady clock is CLOCK_MONOTONIC on Linux, so its times can be used
+// as timerfd deadlines as they are
+
+WakeTimer::WakeTimer()
+{
+    _timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    _event = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+}
+
+WakeTimer::~WakeTimer()
+{
+    if (_timer >= 0)
+    {
+        close(_timer);
+    }
+    if (_event >= 0)
+    {
+        close(_event);
+    }
+}
+
+// The caller is about to do what it was woken up for, so a Wake that came
+// in the meantime must not end the next sleep or spin as well
+void WakeTimer::ClearWake()
+{
+    _woken = false;
+
+    uint64_t count;
+    (void)read(_event, &count, sizeof(count));
+}
+
+void WakeTimer::SleepUntil(
+    long long deadline)
+{
+    if (_timer < 0 || _event < 0)
+    {
+        // Without the descriptors we still sleep, only less precisely
+        std::unique_lock<std::mutex> lock(_lock);
+        auto until = std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(deadline)));
+        _wakeup.wait_until(lock, until, [this]() { return _woken.load(); });
+        _woken = false;
+        return;
+    }
+
+    if (deadline <= SteadyNow())
+    {
+        ClearWake();
+        return;
+    }
+
+    itimerspec spec = {};
+    spec.it_value.tv_sec = time_t(deadline / 1000000000LL);
+    spec.it_value.tv_nsec = long(deadline % 1000000000LL);
+    timerfd_settime(_timer, TFD_TIMER_ABSTIME, &spec, nullptr);
+
+    pollfd fds[2] = {
+        {_timer, POLLIN, 0},
+        {_event, POLLIN, 0},
+    };
+
+    while (poll(fds, 2, -1) < 0 && errno == EINTR)
+    {
+        if (SteadyNow() >= deadline)
+        {
+            break;
+        }
+    }
+
+    uint64_t count;
+    if ((fds[0].revents & POLLIN) != 0)
+    {
+        (void)read(_timer, &count, sizeof(count));
+    }
+    if ((fds[1].revents & POLLIN) != 0)
+    {
+        ClearWake();
+    }
+}
+
+void WakeTimer::Wake()
+{
+    if (_event < 0)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            _woken = true;
+        }
+        _wakeup.notify_one();
+        return;
+    }
+
+    _woken = true;
+    uint64_t one = 1;
+    (void)write(_event, &one, sizeof(one));
+}
+
+#else
+
+WakeTimer::WakeTimer() = default;
+
+WakeTimer::~WakeTimer() = default;
+
+void WakeTimer::SleepUntil(
+    long long deadline)
+{
+    std::unique_lock<std::mutex> lock(_lock);
+    auto until = std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(deadline)));
+    _wakeup.wait_until(lock, until, [this]() { return _woken.load(); });
+    _woken = false;
+}
+
+void WakeTimer::Wake()
+{
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        _woken = true;
+    }
+    _wakeup.notify_one();
+}
+
+#endif
+
+void WakeTimer::SpinUntil(
+    long long deadline)
+{
+    while (!_woken.load(std::memory_order_relaxed) && SteadyNow() < deadline)
+    {
+        Relax();
+    }
+}
@@ -0,0 +1,475 @@
+#include <capturesink.hpp>
+#include <engine.hpp>
+#include <loopbacksink.hpp>
+#include <offlinerender.hpp>
+#include <session.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const char *arpModeNames[] = {
+    "up",
+    "down",
+    "inclusive",
+    "exclusive",
+    "random",
+    "order",
+};
+
+static std::string goldenDirectory;
+static bool updateGolden = false;
+
+// Two channels in the same mode. The second one plays whole steps, so its
+// note-off falls together with the next note-on of both channels.
+static tSession ModeSession(
+    int arpMode)
+{
+    tSession session;
+    session._bpm = 120.0f;
+    session._seed = 7;
+
+    tSessionChannel lead;
+    lead._name = "Lead";
+    lead._channel = 0;
+    lead._arpMode = arpMode;
+    lead._noteLength = 0.5f;
+    lead._notes = {72, 60, 67, 64};
+    session._channels.push_back(lead);
+
+    tSessionChannel bass;
+    bass._name = "Bass";
+    bass._channel = 1;
+    bass._arpMode = arpMode;
+    bass._velocity = 90;
+    bass._noteLength = 1.0f;
+    bass._notes = {36, 43, 48};
+    session._channels.push_back(bass);
+
+    return session;
+}
+
+// Compares the event list with the golden file of that name, or writes it
+// when the golden files are being updated
+static bool MatchesGolden(
+    const std::string &name,
+    const std::string &events)
+{
+    auto path = goldenDirectory + "/" + name + ".txt";
+
+    if (updateGolden)
+    {
+        std::ofstream file(path);
+        file << events;
+        return file.good();
+    }
+
+    std::ifstream file(path);
+    if (!file.is_open())
+    {
+        std::cerr << "  cannot open " << path << std::endl;
+        return false;
+    }
+
+    std::stringstream actual(events);
+    std::string expectedLine;
+    std::string actualLine;
+    for (int line = 1;; line++)
+    {
+        bool moreExpected = bool(std::getline(file, expectedLine));
+        bool moreActual = bool(std::getline(actual, actualLine));
+        if (!moreExpected && !moreActual)
+        {
+            return true;
+        }
+
+        if (moreExpected != moreActual || expectedLine != actualLine)
+        {
+            std::cerr << "  " << path << ":" << line << ": expected \"" << (moreExpected ? expectedLine : "<end>")
+                      << "\", got \"" << (moreActual ? actualLine : "<end>") << "\"" << std::endl;
+            return false;
+        }
+    }
+}
+
+static bool TestArpMode(
+    int arpMode)
+{
+    OfflineRenderer renderer;
+    renderer.Render(ModeSession(arpMode), 2);
+
+    std::stringstream events;
+    renderer.WriteEventList(events);
+
+    return MatchesGolden(arpModeNames[arpMode], events.str());
+}
+
+// The same session renders to the same list every time, Random included
+static bool TestRepeatable()
+{
+    std::stringstream first;
+    std::stringstream second;
+
+    OfflineRenderer one;
+    one.Render(ModeSession(ArpModes::Random), 4);
+    one.WriteEventList(first);
+
+    OfflineRenderer other;
+    other.Render(ModeSession(ArpModes::Random), 4);
+    other.WriteEventList(second);
+
+    return first.str() == second.str();
+}
+
+// Plays the Up session on a running engine into a loopback sink. What comes
+// back is in time order, every note-on of the lead follows the pool upwards,
+// and stopping turns every note off again.
+static bool TestLoopback()
+{
+    auto session = ModeSession(ArpModes::Up);
+    session._bpm = 600.0f;
+
+    LoopbackSink sink;
+    Engine engine;
+    engine.Start(&sink);
+    PostSession(engine, session);
+    engine.PostWaiting({EngineCommandTypes::SetPlaying, 0, 0, 1});
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(450));
+
+    engine.PostWaiting({EngineCommandTypes::SetPlaying, 0, 0, 0});
+    engine.Stop();
+
+    std::vector<tMidiMessage> messages;
+    tMidiMessage message;
+    while (sink.Receive(message))
+    {
+        messages.push_back(message);
+    }
+
+    if (sink.Dropped() != 0 || messages.empty())
+    {
+        std::cerr << "  received " << messages.size() << ", dropped " << sink.Dropped() << std::endl;
+        return false;
+    }
+
+    const unsigned char upwards[] = {60, 64, 67, 72};
+    size_t leadNotes = 0;
+    int sounding = 0;
+    for (size_t i = 0; i < messages.size(); i++)
+    {
+        auto &m = messages[i];
+        if (i > 0 && m._time < messages[i - 1]._time)
+        {
+            std::cerr << "  message " << i << " is due before the one sent ahead of it" << std::endl;
+            return false;
+        }
+
+        auto type = m._data[0] & 0xF0;
+        if (type == 0x90 && m._data[2] != 0)
+        {
+            if ((m._data[0] & 0x0F) == 0 && m._data[1] != upwards[leadNotes++ % 4])
+            {
+                std::cerr << "  lead note " << leadNotes << " is " << int(m._data[1]) << std::endl;
+                return false;
+            }
+            sounding++;
+        }
+        else if (type == 0x80 || type == 0x90)
+        {
+            sounding--;
+        }
+    }
+
+    if (leadNotes < 2 || sounding != 0)
+    {
+        std::cerr << "  " << leadNotes << " lead notes, " << sounding << " still sounding" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// What a capture sink wrote reads back the same, batches included
+static bool TestCapture()
+{
+    const std::string path = "arp_tests.capture";
+    const unsigned char noteOn[] = {0x90, 60, 100};
+    const unsigned char clock[] = {0xF8};
+
+    std::vector<tMidiMessage> sent(3);
+    sent[0]._time = 0;
+    std::copy(noteOn, noteOn + 3, sent[0]._data);
+    sent[0]._size = 3;
+    sent[1]._time = 20833333;
+    sent[1]._data[0] = clock[0];
+    sent[1]._size = 1;
+    sent[2]._time = 5000000000LL;
+    sent[2]._data[0] = 0x80;
+    sent[2]._data[1] = 60;
+    sent[2]._data[2] = 0;
+    sent[2]._size = 3;
+
+    {
+        CaptureSink sink(path);
+        if (!sink.Init())
+        {
+            return false;
+        }
+
+        // Nothing is captured before the port is open
+        sink.Send(0, clock, sizeof(clock));
+
+        sink.OpenPort(0);
+        sink.Send(sent[0]._time, noteOn, sizeof(noteOn));
+        sink.SendBatch(sent.data() + 1, 2);
+        sink.ClosePort();
+    }
+
+    std::vector<tMidiMessage> read;
+    std::string error;
+    bool ok = ReadCapture(path, read, error);
+    std::remove(path.c_str());
+
+    if (!ok)
+    {
+        std::cerr << "  " << error << std::endl;
+        return false;
+    }
+
+    if (read.size() != sent.size())
+    {
+        std::cerr << "  read " << read.size() << " messages" << std::endl;
+        return false;
+    }
+
+    for (size_t i = 0; i < sent.size(); i++)
+    {
+        if (read[i]._time != sent[i]._time || read[i]._size != sent[i]._size ||
+            !std::equal(sent[i]._data, sent[i]._data + sent[i]._size, read[i]._data))
+        {
+            std::cerr << "  message " << i << " differs" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Remembers the port every message went to, and like a real port drops
+// what is sent while it is closed
+class PortSink : public MidiSink
+{
+public:
+    struct tPortMessage
+    {
+        int _port = 0;
+        tMidiMessage _message;
+    };
+
+    std::vector<tPortMessage> _messages;
+
+    bool Init() override
+    {
+        return true;
+    }
+
+    std::vector<std::string> PortNames() override
+    {
+        return {"zero", "one"};
+    }
+
+    void OpenPort(
+        unsigned int port) override
+    {
+        _port = int(port);
+    }
+
+    void ClosePort() override
+    {
+        _port = -1;
+    }
+
+    void Send(
+        long long time,
+        const unsigned char *message,
+        size_t size) override
+    {
+        if (_port < 0 || size == 0 || size > 3)
+        {
+            return;
+        }
+
+        tPortMessage sent;
+        sent._port = _port;
+        sent._message._time = time;
+        std::copy(message, message + size, sent._message._data);
+        sent._message._size = static_cast<unsigned char>(size);
+        _messages.push_back(sent);
+    }
+
+private:
+    int _port = 0;
+};
+
+// Engine on a virtual clock that the test drives by hand
+class HandEngine : public Engine
+{
+public:
+    HandEngine(
+        MidiSink *sink)
+    {
+        SetClock(&_virtualClock);
+        _sink = sink;
+    }
+
+    void Command(
+        const tEngineCommand &command)
+    {
+        Apply(command);
+        Flush();
+    }
+
+    void Tick()
+    {
+        auto nextDue = RunNotes();
+        Flush();
+        _virtualClock.Set(std::max(nextDue, Now() + 1));
+    }
+
+private:
+    VirtualClock _virtualClock;
+};
+
+// Switching or closing the port while a note sounds turns it off on the port
+// it was played on, not on the next one
+static bool TestPortSwitch(
+    EngineCommandTypes switchCommand)
+{
+    PortSink sink;
+    HandEngine engine(&sink);
+
+    engine.Command({EngineCommandTypes::OpenPort, 0, 0, 0});
+    engine.Command({EngineCommandTypes::SetBpm, 0, 0, 0, 120.0f});
+    engine.Command({EngineCommandTypes::AddChannel});
+    engine.Command({EngineCommandTypes::SetNoteLength, 0, 0, 0, 0.9f});
+    engine.Command({EngineCommandTypes::AddNote, 0, 60});
+    engine.Command({EngineCommandTypes::SetPlaying, 0, 0, 1});
+    engine.Tick();
+
+    engine.Command({switchCommand, 0, 0, 1});
+    engine.Command({EngineCommandTypes::SetPlaying, 0, 0, 0});
+
+    int sounding[2] = {0, 0};
+    for (auto &sent : sink._messages)
+    {
+        auto type = sent._message._data[0] & 0xF0;
+        if (type == 0x90 && sent._message._data[2] != 0)
+        {
+            sounding[sent._port]++;
+        }
+        else if (type == 0x80 || type == 0x90)
+        {
+            sounding[sent._port]--;
+        }
+    }
+
+    if (sink._messages.empty() || sounding[0] != 0 || sounding[1] != 0)
+    {
+        std::cerr << "  " << sounding[0] << " notes hang on port 0, " << sounding[1] << " on port 1" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// A session with more channels than the engine has is refused where the
+// first one too many starts, one that fills every channel loads
+static bool TestChannelLimit()
+{
+    const std::string path = "arp_tests.arp";
+    auto write = [&path](size_t channels) {
+        std::ofstream file(path);
+        for (size_t i = 0; i < channels; i++)
+        {
+            file << "channel " << i << "\nnotes 60\n";
+        }
+    };
+
+    std::string error;
+
+    write(Engine::MaxChannels);
+    tSession full;
+    bool fullLoaded = LoadSession(path, full, error);
+
+    write(Engine::MaxChannels + 1);
+    tSession tooMany;
+    bool tooManyLoaded = LoadSession(path, tooMany, error);
+    std::remove(path.c_str());
+
+    auto expected = path + ":" + std::to_string(2 * Engine::MaxChannels + 1) + ": more than " +
+                    std::to_string(Engine::MaxChannels) + " channels";
+    if (!fullLoaded || tooManyLoaded || error != expected)
+    {
+        std::cerr << "  " << error << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    const std::vector<std::string> args(argv + 1, argv + argc);
+
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        if (args[i] == "--update")
+        {
+            updateGolden = true;
+        }
+        else if (goldenDirectory.empty())
+        {
+            goldenDirectory = args[i];
+        }
+        else
+        {
+            std::cout << "usage: arp_tests [--update] <golden directory>\n";
+            return 1;
+        }
+    }
+
+    if (goldenDirectory.empty())
+    {
+        std::cout << "usage: arp_tests [--update] <golden directory>\n";
+        return 1;
+    }
+
+    int failures = 0;
+    auto run = [&failures](const std::string &name, bool passed) {
+        std::cout << (passed ? "pass " : "FAIL ") << name << std::endl;
+        if (!passed)
+        {
+            failures++;
+        }
+    };
+
+    for (int arpMode = ArpModes::Up; arpMode <= ArpModes::Order; arpMode++)
+    {
+        run(std::string("mode ") + arpModeNames[arpMode], TestArpMode(arpMode));
+    }
+    run("repeatable", TestRepeatable());
+    run("loopback", TestLoopback());
+    run("capture", TestCapture());
+    run("channel limit", TestChannelLimit());
+    run("open another port", TestPortSwitch(EngineCommandTypes::OpenPort));
+    run("close the port", TestPortSwitch(EngineCommandTypes::ClosePort));
+
+    return failures == 0 ? 0 : 1;
+}